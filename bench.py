@@ -0,0 +1,161 @@
+#! /usr/bin/env python3
+# Benchmark drivers for the socket server. Each subcommand starts ./server
+# with the options under test, points a load generator at it and prints a
+# table. Build the binaries first (see README.md).
+import os
+import re
+import sys
+import time
+import signal
+import subprocess
+from optparse import OptionParser
+
+
+def start_server(args, port):
+    server = subprocess.Popen(["./server", "-p", str(port)] + args,
+                              stdout=subprocess.DEVNULL, stderr=subprocess.PIPE)
+    time.sleep(0.5)
+    return server
+
+
+def stop_server(server):
+    server.send_signal(signal.SIGTERM)
+    _, err = server.communicate()
+    return err.decode()
+
+
+def bench_conns(args, port):
+    """Run bench_conns for one point; returns (msgs/s, p50 us, p99 us)."""
+    out = subprocess.run(["./bench_conns", "-p", str(port)] + args,
+                         check=True, stdout=subprocess.PIPE).stdout.decode()
+    # Last line of the table is the single measurement point we asked for.
+    fields = out.strip().splitlines()[-1].split()
+    return float(fields[2]), float(fields[3]), float(fields[4])
+
+
+def syscalls_per_message(server_stderr):
+    match = re.search(r"syscalls/message ([0-9.]+)", server_stderr)
+    return float(match.group(1)) if match else float("nan")
+
+
+def cores(options):
+    """Messages per second as the number of server workers grows."""
+    max_threads = options.max_threads or os.cpu_count()
+    base = None
+    print("%8s %14s %9s" % ("workers", "msgs/s", "speedup"))
+    for n in range(1, max_threads + 1):
+        server = start_server(["-t", str(n)], options.port)
+        try:
+            rate, _, _ = bench_conns(["-t", str(n), "-a", str(options.active * n),
+                                "-d", str(options.duration), str(options.active * n)],
+                               options.port)
+        finally:
+            stop_server(server)
+        base = base or rate
+        print("%8d %14.0f %9.2f" % (n, rate, rate / base))
+
+
+def backends(options):
+    """epoll vs io_uring at the same load: throughput, latency, syscalls."""
+    print("%8s %14s %9s %9s %13s" % ("backend", "msgs/s", "p50(us)", "p99(us)", "syscalls/msg"))
+    for backend in ("epoll", "uring"):
+        server = start_server(["-b", backend], options.port)
+        try:
+            rate, p50, p99 = bench_conns(["-a", str(options.active), "-w", str(options.window),
+                                          "-d", str(options.duration), str(options.active)],
+                                         options.port)
+        finally:
+            err = stop_server(server)
+        print("%8s %14.0f %9.1f %9.1f %13.3f" % (backend, rate, p50, p99, syscalls_per_message(err)))
+
+
+def bulk(options):
+    """Bulk download through the copy, sendfile and MSG_ZEROCOPY paths."""
+    size = str(options.bulk_bytes)
+    print("%10s %12s %16s %16s" % ("mode", "MB/s", "client CPU s/GB", "server CPU s/GB"))
+    for mode in ("copy", "sendfile", "zerocopy"):
+        server = subprocess.Popen(["./server", "-p", str(options.port), "-z", mode],
+                                  stdout=subprocess.PIPE, stderr=subprocess.DEVNULL)
+        time.sleep(0.5)
+        try:
+            out = subprocess.run(["./client", "-p", str(options.port), "-B", size],
+                                 check=True, stdout=subprocess.PIPE).stdout.decode()
+        finally:
+            server.send_signal(signal.SIGTERM)
+            server_out, _ = server.communicate()
+        rate = re.search(r"([0-9.]+) MB/s", out).group(1)
+        client_cpu = re.search(r"([0-9.]+) CPU s/GB", out).group(1)
+        server_cpu = re.search(r"([0-9.e+-]+) CPU s/GB", server_out.decode())
+        print("%10s %12s %16s %16s" % (mode, rate, client_cpu,
+                                      server_cpu.group(1) if server_cpu else "?"))
+
+
+def udp(options):
+    """UDP request/reply with plain recvmmsg/sendmmsg and with GSO/GRO."""
+    print("%8s %12s %9s %9s %9s %13s" % ("offload", "pkt/s", "lost(%)", "p50(us)", "p99(us)",
+                                         "syscalls/msg"))
+    for offload in ([], ["-g"]):
+        server = start_server(["-u"] + offload, options.port)
+        try:
+            out = subprocess.run(["./client", "-p", str(options.port), "-u", "-l"] + offload +
+                                 ["-c", str(options.active), "-i", str(options.window),
+                                  "-d", str(options.duration)],
+                                 check=True, stdout=subprocess.PIPE).stdout.decode()
+        finally:
+            err = stop_server(server)
+        rate = float(re.search(r"([0-9.]+) pkt/s in", out).group(1))
+        lost = float(re.search(r"lost [0-9]+ \(([0-9.]+)%\)", out).group(1))
+        p50, p99 = [float(x) for x in out.strip().splitlines()[-1].split()[0:3:2]]
+        print("%8s %12.0f %9.3f %9.1f %9.1f %13.3f" % ("gso/gro" if offload else "none", rate, lost,
+                                                       p50, p99, syscalls_per_message(err)))
+
+
+def shm(options):
+    """Loopback TCP vs the shared-memory rings at the same closed-loop load."""
+    path = "/tmp/bench-shm-%d.sock" % options.port
+    print("%10s %14s %9s %9s %13s" % ("transport", "msgs/s", "p50(us)", "p99(us)", "syscalls/msg"))
+    for transport in ("tcp", "shm"):
+        server = start_server(["-m", path], options.port)
+        try:
+            target = ["-m", path] if transport == "shm" else ["-p", str(options.port)]
+            out = subprocess.run(["./client", "-l", "-c", str(options.active), "-i", str(options.window),
+                                  "-d", str(options.duration)] + target,
+                                 check=True, stdout=subprocess.PIPE).stdout.decode()
+        finally:
+            err = stop_server(server)
+        rate = float(re.search(r"throughput ([0-9.]+)", out).group(1))
+        p50, p99 = [float(x) for x in out.strip().splitlines()[-1].split()[0:3:2]]
+        # Server side only: I/O syscalls for TCP, futex calls for shm
+        if transport == "shm":
+            match = re.search(r"shm: .*syscalls/message ([0-9.]+)", err)
+            syscalls = float(match.group(1)) if match else float("nan")
+        else:
+            syscalls = syscalls_per_message(err)
+        print("%10s %14.0f %9.1f %9.1f %13.3f" % (transport, rate, p50, p99, syscalls))
+
+
+def main(argv):
+    parser = OptionParser(usage="%prog [options] cores|backends|bulk|udp|shm")
+    parser.add_option('--port', type="int", default=12400, dest='port',
+                      help="Port the server under test listens on")
+    parser.add_option('--duration', type="float", default=5.0, dest='duration',
+                      help="Seconds per measurement point")
+    parser.add_option('--active', type="int", default=64, dest='active',
+                      help="Active connections per worker")
+    parser.add_option('--window', type="int", default=1, dest='window',
+                      help="Requests pipelined per connection")
+    parser.add_option('--bulk-bytes', type="int", default=4 << 30, dest='bulk_bytes',
+                      help="Bytes per bulk transfer")
+    parser.add_option('--max-threads', type="int", default=0, dest='max_threads',
+                      help="Largest worker count to try (default: all cores)")
+    (options, args) = parser.parse_args(argv[1:])
+
+    commands = {"cores": cores, "backends": backends, "bulk": bulk, "udp": udp, "shm": shm}
+    if len(args) != 1 or args[0] not in commands:
+        parser.error("expected one of: " + ", ".join(sorted(commands)))
+    commands[args[0]](options)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
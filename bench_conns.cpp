@@ -0,0 +1,237 @@
+// Connections-vs-throughput benchmark for server.cpp.
+//
+// For every connection count given on the command line it opens that many
+// sockets to the server, keeps `-a` of them busy with request/reply
+// ping-pong for `-d` seconds and leaves the rest idle, then prints the
+// reply rate. A server that scales keeps the rate flat as idle
+// connections pile up. `-t` spreads the connections over several driver
+// threads so a multi-worker server (server -t N) can be saturated, and
+// `-w` keeps that many requests pipelined on each active connection.
+// Request latency (send to matching reply) is reported as p50/p99.
+//
+//   ./bench_conns -a 64 -d 5 1 100 1000 10000
+//   ./bench_conns -t 4 -a 256 -d 5 1000
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <deque>
+#include <unordered_map>
+#include <thread>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <chrono>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+
+#include "protocol.h"
+#include "histogram.h"
+
+#define PORT 12345
+#define BUFFER_SIZE 16384
+#define MAX_EVENTS 1024
+
+using namespace std;
+
+static void raise_fd_limit() {
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+}
+
+static int connect_to(const struct sockaddr_in &addr) {
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0)
+        return -1;
+    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(sock);
+        return -1;
+    }
+    int one = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return sock;
+}
+
+struct Peer {
+    string in;                  // partial reply frame
+    deque<uint64_t> sent_ns;    // send time of every outstanding request
+};
+
+static uint64_t now_ns() {
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Keeps `window` requests outstanding on every socket in `active` until
+// `deadline`, recording each request's latency in `latency`; returns the
+// number of replies received.
+static long drive(const vector<int> &active, int window, chrono::steady_clock::time_point deadline,
+                  Histogram &latency) {
+    string request;
+    append_frame(request, OP_MESSAGE, "ping", 4);
+    string burst;
+    for (int i = 0; i < window; i++)
+        burst += request;
+
+    int epfd = epoll_create1(0);
+    unordered_map<int, Peer> peers;
+    for (int fd : active) {
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+        Peer &peer = peers[fd];
+        peer.sent_ns.assign(window, now_ns());
+        send(fd, burst.data(), burst.size(), MSG_NOSIGNAL);
+    }
+
+    long replies = 0;
+    char buffer[BUFFER_SIZE];
+    string refill;
+    struct epoll_event events[MAX_EVENTS];
+    while (chrono::steady_clock::now() < deadline) {
+        int n = epoll_wait(epfd, events, MAX_EVENTS, 100);
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+            int valread = read(fd, buffer, BUFFER_SIZE);
+            if (valread <= 0)
+                continue;
+
+            // Count the complete replies and send the same number of new
+            // requests back in one write.
+            Peer &peer = peers[fd];
+            string &in = peer.in;
+            in.append(buffer, valread);
+            size_t used = 0;
+            refill.clear();
+            Frame frame;
+            long len;
+            uint64_t now = now_ns();
+            while ((len = parse_frame(in.data() + used, in.size() - used, frame)) > 0) {
+                used += len;
+                replies++;
+                latency.record(now - peer.sent_ns.front());
+                peer.sent_ns.pop_front();
+                peer.sent_ns.push_back(now);
+                refill += request;
+            }
+            in.erase(0, used);
+            if (!refill.empty())
+                send(fd, refill.data(), refill.size(), MSG_NOSIGNAL);
+        }
+    }
+    close(epfd);
+    return replies;
+}
+
+// Runs one measurement point and returns replies per second, or -1 if the
+// connections could not be opened. Latencies of all threads are merged
+// into `latency`.
+static double measure(const struct sockaddr_in &addr, int total, int active, int threads, int window,
+                      double seconds, Histogram &latency) {
+    vector<int> socks;
+    socks.reserve(total);
+    for (int i = 0; i < total; i++) {
+        int s = connect_to(addr);
+        if (s < 0) {
+            cerr << "Connection " << i << " failed: " << strerror(errno) << "\n";
+            for (int fd : socks)
+                close(fd);
+            return -1;
+        }
+        socks.push_back(s);
+    }
+
+    if (active > total)
+        active = total;
+    vector<vector<int>> shares(threads);
+    for (int i = 0; i < active; i++)
+        shares[i % threads].push_back(socks[i]);
+
+    vector<long> replies(threads, 0);
+    vector<Histogram> latencies(threads);
+    vector<thread> drivers;
+    auto start = chrono::steady_clock::now();
+    auto deadline = start + chrono::duration_cast<chrono::steady_clock::duration>(
+                                chrono::duration<double>(seconds));
+    for (int t = 0; t < threads; t++)
+        drivers.emplace_back([&, t] { replies[t] = drive(shares[t], window, deadline, latencies[t]); });
+    for (thread &d : drivers)
+        d.join();
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    for (int fd : socks)
+        close(fd);
+    long sum = 0;
+    for (int t = 0; t < threads; t++) {
+        sum += replies[t];
+        latency.merge(latencies[t]);
+    }
+    return sum / elapsed;
+}
+
+int main(int argc, char *argv[]) {
+    const char *host = "127.0.0.1";
+    int port = PORT;
+    int active = 64;
+    int threads = 1;
+    int window = 1;
+    double seconds = 5.0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "h:p:a:t:w:d:")) != -1) {
+        switch (opt) {
+        case 'h': host = optarg; break;
+        case 'p': port = atoi(optarg); break;
+        case 'a': active = atoi(optarg); break;
+        case 't': threads = atoi(optarg); break;
+        case 'w': window = atoi(optarg); break;
+        case 'd': seconds = atof(optarg); break;
+        default:
+            cerr << "Usage: " << argv[0] << " [-h host] [-p port] [-a active] [-t threads] [-w window] [-d seconds] connections...\n";
+            return 1;
+        }
+    }
+
+    vector<int> counts;
+    for (int i = optind; i < argc; i++)
+        counts.push_back(atoi(argv[i]));
+    if (threads < 1)
+        threads = 1;
+    if (window < 1)
+        window = 1;
+    if (counts.empty())
+        counts = {1, 10, 100, 1000, 10000};
+
+    raise_fd_limit();
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, host, &addr.sin_addr) <= 0) {
+        cerr << "Invalid address/ Address not supported\n";
+        return 1;
+    }
+
+    cout << setw(12) << "connections" << setw(8) << "active" << setw(14) << "msgs/s"
+         << setw(10) << "p50(us)" << setw(10) << "p99(us)" << "\n";
+    for (int total : counts) {
+        Histogram latency;
+        double rate = measure(addr, total, active, threads, window, seconds, latency);
+        if (rate < 0)
+            return 1;
+        cout << setw(12) << total << setw(8) << min(active, total)
+             << setw(14) << fixed << setprecision(0) << rate << setprecision(1)
+             << setw(10) << latency.percentile(50) / 1e3
+             << setw(10) << latency.percentile(99) / 1e3 << "\n" << flush;
+    }
+    return 0;
+}
@@ -0,0 +1,51 @@
+// Queue discipline at a scenario's bottleneck device. A name is a QueueDisc
+// TypeId in full ("ns3::FifoQueueDisc") or short ("Fifo", "FqCoDel",
+// "Red"); "default" leaves whatever Ipv4AddressHelper::Assign() installs on
+// its own, "none" removes it so packets go straight to the device queue.
+#ifndef BOTTLENECK_H
+#define BOTTLENECK_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/traffic-control-module.h"
+
+#include <string>
+
+inline std::string
+QueueDiscTypeName(const std::string &name)
+{
+    return name.compare(0, 5, "ns3::") == 0 ? name : "ns3::" + name + "QueueDisc";
+}
+
+inline bool
+IsQueueDiscName(const std::string &name)
+{
+    ns3::TypeId tid;
+    return name == "default" || name == "none" ||
+           ns3::TypeId::LookupByNameFailSafe(QueueDiscTypeName(name), &tid);
+}
+
+// Call before addresses are assigned: Assign() only installs ns-3's
+// default on devices that have no queue disc yet.
+inline void
+InstallBottleneckQueue(ns3::Ptr<ns3::NetDevice> device, const std::string &name)
+{
+    if (name != "none" && name != "default")
+    {
+        ns3::TrafficControlHelper trafficControl;
+        trafficControl.SetRootQueueDisc(QueueDiscTypeName(name));
+        trafficControl.Install(device);
+    }
+}
+
+// Call after addresses are assigned.
+inline void
+FinishBottleneckQueue(ns3::Ptr<ns3::NetDevice> device, const std::string &name)
+{
+    if (name == "none")
+    {
+        ns3::TrafficControlHelper().Uninstall(device);
+    }
+}
+
+#endif
@@ -0,0 +1,132 @@
+// Per-worker buffer pool for connection I/O.
+//
+// Buffers of POOL_BUF_SIZE bytes are carved out of large slabs and kept on
+// an intrusive free list, so taking or returning one is a pointer swap and
+// never touches the heap once the pool has grown to its high-water mark.
+// An IoBuffer only holds a pool buffer while it has bytes in it: idle
+// connections cost no buffer memory at all. Frames that do not fit in one
+// pool buffer (up to MAX_FRAME_SIZE) spill to a heap buffer, which is the
+// only case that allocates per message.
+//
+// A pool is owned by one worker thread and is not thread-safe.
+#ifndef BUFPOOL_H
+#define BUFPOOL_H
+
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+#define POOL_BUF_SIZE 16384
+#define POOL_SLAB_BUFFERS 256
+
+struct BufferPool {
+    struct FreeBuffer {
+        FreeBuffer *next;
+    };
+
+    FreeBuffer *free_list = nullptr;
+    std::vector<char *> slabs;
+    size_t in_use = 0;
+
+    ~BufferPool() {
+        for (char *slab : slabs)
+            delete[] slab;
+    }
+
+    char *get() {
+        if (!free_list)
+            grow();
+        FreeBuffer *buf = free_list;
+        free_list = buf->next;
+        in_use++;
+        return (char *)buf;
+    }
+
+    void put(char *data) {
+        FreeBuffer *buf = (FreeBuffer *)data;
+        buf->next = free_list;
+        free_list = buf;
+        in_use--;
+    }
+
+    void grow() {
+        char *slab = new char[(size_t)POOL_SLAB_BUFFERS * POOL_BUF_SIZE];
+        slabs.push_back(slab);
+        for (int i = POOL_SLAB_BUFFERS - 1; i >= 0; i--) {
+            FreeBuffer *buf = (FreeBuffer *)(slab + (size_t)i * POOL_BUF_SIZE);
+            buf->next = free_list;
+            free_list = buf;
+        }
+    }
+};
+
+// Byte queue backed by a pool buffer: bytes are appended at `end` and
+// consumed from `start`; the buffer goes back to the pool as soon as it
+// is drained.
+struct IoBuffer {
+    char *buf = nullptr;
+    size_t cap = 0, start = 0, end = 0;
+
+    const char *data() const { return buf + start; }
+    size_t size() const { return end - start; }
+    bool empty() const { return start == end; }
+
+    void append(BufferPool &pool, const char *src, size_t len) {
+        if (len == 0)
+            return;
+        reserve(pool, len);
+        memcpy(buf + end, src, len);
+        end += len;
+    }
+
+    void consume(BufferPool &pool, size_t len) {
+        start += len;
+        if (start == end)
+            release(pool);
+    }
+
+    void release(BufferPool &pool) {
+        if (buf) {
+            if (cap == POOL_BUF_SIZE)
+                pool.put(buf);
+            else
+                delete[] buf;
+        }
+        buf = nullptr;
+        cap = start = end = 0;
+    }
+
+    // Make room for `len` more bytes: take a pool buffer, slide the live
+    // bytes to the front, or as a last resort move to a larger heap buffer.
+    void reserve(BufferPool &pool, size_t len) {
+        if (!buf) {
+            if (len <= POOL_BUF_SIZE) {
+                buf = pool.get();
+                cap = POOL_BUF_SIZE;
+                return;
+            }
+        } else if (cap - end >= len) {
+            return;
+        } else if (cap - size() >= len) {
+            memmove(buf, buf + start, size());
+            end -= start;
+            start = 0;
+            return;
+        }
+
+        size_t need = size() + len;
+        size_t new_cap = POOL_BUF_SIZE * 2;
+        while (new_cap < need)
+            new_cap *= 2;
+        char *bigger = new char[new_cap];
+        size_t live = size();
+        if (buf)
+            memcpy(bigger, buf + start, live);
+        release(pool);
+        buf = bigger;
+        cap = new_cap;
+        end = live;
+    }
+};
+
+#endif
@@ -1,53 +1,110 @@
 #include <iostream>
+#include <iomanip>
 #include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <csignal>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <string_view>
+#include <thread>
+#include <vector>
 #include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/uio.h>
 #include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <fcntl.h>
 #include <unistd.h>
+#include <string>
+
+#include "protocol.h"
+#include "histogram.h"
+#include "shmring.h"
+#include "sockbuf.h"
+#include "udp.h"
+#include "unixsock.h"
+
 using namespace std;
-#define PORT 123
-#define BUFFER_SIZE 1024
+#define PORT 12345
+#define BUFFER_SIZE 16384
+#define MAX_EVENTS 1024
+#define WRITEV_BATCH 1024                   // queued requests handed to one writev
+#define WRITEV_COPY_MAX 512                 // smaller requests are copied together into one iovec
+#define BULK_BUFFER_SIZE (4 << 20)
+#define UDP_REPLY_TIMEOUT_MS 1000
+#define UDP_LOSS_TIMEOUT_NS 200000000ULL    // closed loop: unanswered requests count as lost after this
+#define UDP_DRAIN_NS 200000000ULL           // replies still accepted after the run ends
+#define UDP_SEQ_WINDOW 65536                // send times remembered per socket
 
-int main() {
+static SocketBufferSpec socket_buffers;     // -w, applied to every TCP connection
+
+// Block until one complete frame is buffered in `in`, then move it into
+// `reply`. Returns false if the connection drops or sends garbage.
+static bool read_frame(int sock, string &in, uint8_t &opcode, string &reply) {
+    char buffer[BUFFER_SIZE];
+    while (true) {
+        Frame frame;
+        long n = parse_frame(in.data(), in.size(), frame);
+        if (n < 0)
+            return false;
+        if (n > 0) {
+            opcode = frame.opcode;
+            reply.assign(frame.payload, frame.length);
+            in.erase(0, n);
+            return true;
+        }
+        int valread = read(sock, buffer, BUFFER_SIZE);
+        if (valread <= 0)
+            return false;
+        in.append(buffer, valread);
+    }
+}
+
+static int connect_to(const struct sockaddr_in &serv_addr) {
     int sock = 0;
-    struct sockaddr_in serv_addr;
-    char buffer[BUFFER_SIZE] = {0};
 
     // Creating socket file descriptor
     if ((sock = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
         cerr << "Socket creation error\n";
         return -1;
     }
-
-    serv_addr.sin_family = AF_INET;
-    serv_addr.sin_port = htons(PORT);
-
-    // Convert IPv4 and IPv6 addresses from text to binary form
-    if (inet_pton(AF_INET, "127.0.0.1", &serv_addr.sin_addr) <= 0) {
-         cerr << "Invalid address/ Address not supported\n";
-        return -1;
-    }
+    apply_socket_buffers(sock, socket_buffers);
 
     // Connect to the server
     if (connect(sock, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0) {
          cerr << "Connection failed\n";
+        close(sock);
         return -1;
     }
+    return sock;
+}
 
+static int run_interactive(int sock) {
      cout << "Connected to server\n";
 
+    string in, out, reply;
     while (true) {
          string message;
          cout << "Enter your message: ";
-         getline( cin, message);
+         if (!getline( cin, message))
+             break;
 
-        send(sock, message.c_str(), message.size(), 0);
+        out.clear();
+        append_frame(out, OP_MESSAGE, message);
+        send(sock, out.data(), out.size(), 0);
 
-        memset(buffer, 0, BUFFER_SIZE);
-        int valread = read(sock, buffer, BUFFER_SIZE);
+        uint8_t opcode;
+        if (!read_frame(sock, in, opcode, reply) || opcode != OP_REPLY) {
+            cerr << "Connection lost\n";
+            break;
+        }
 
-         cout << "Server replied: " << buffer << "\n";
+         cout << "Server replied: " << reply << "\n";
 
-        if (message == "Quit" &&  string(buffer) == "Goodbye") {
+        if (message == "Quit" && reply == "Goodbye") {
              cout << "Exiting...\n";
             break;
         }
@@ -56,3 +113,996 @@ int main() {
     close(sock);
     return 0;
 }
+
+// ---------------------------------------------------------------------------
+// Load generator
+//
+// Closed loop (-i N): every connection keeps N requests outstanding and
+// sends a new one as soon as a reply arrives, so the offered load adapts
+// to the server. Open loop (-r RATE): requests are issued on a fixed
+// schedule regardless of how fast replies come back. A stalled server
+// would otherwise silently lower the number of samples taken during the
+// stall (coordinated omission), so open-loop latency is measured from the
+// time a request *should* have been sent; the uncorrected figures, taken
+// from the actual send time, are printed alongside for comparison.
+//
+// Requests are encoded once up front: one generated payload (-s), or one
+// frame per line of a file (-F). Whatever a connection has queued goes
+// to the kernel with a single writev, so a window of N requests costs one
+// syscall. Large frames are passed by reference; runs of small ones are
+// copied back to back into one iovec, since the kernel's cost per iovec
+// is higher than copying a few dozen bytes. Replies arrive
+// in request order on each connection and are matched to their send
+// times by position. Without -l, -F is a batch: every line is sent
+// exactly once, through the same windows, and the run ends when the last
+// reply is in.
+// ---------------------------------------------------------------------------
+
+struct LoadOptions {
+    int connections = 1;
+    double rate = 0;            // requests/s over all connections; 0 = closed loop
+    int inflight = 1;           // closed loop: outstanding requests per connection
+    size_t payload = 16;
+    double duration = 10;
+    const char *request_file = nullptr;    // -F: one request per line, "-" for stdin
+    bool batch = false;                    // send the file once instead of cycling it
+};
+
+// The frames the load generator sends, shared by all connections.
+struct RequestSource {
+    vector<string> frames;
+    size_t next = 0;
+    bool once = false;
+
+    bool exhausted() const { return once && next == frames.size(); }
+
+    const string &take() {
+        const string &frame = frames[next++];
+        if (!once && next == frames.size())
+            next = 0;
+        return frame;
+    }
+};
+
+// Encode the requests of `opt`. Returns false if the file cannot be read,
+// is empty or has a line too long for one frame.
+static bool load_requests(const LoadOptions &opt, RequestSource &source) {
+    source.once = opt.batch;
+    if (!opt.request_file) {
+        source.frames.emplace_back();
+        append_frame(source.frames.back(), OP_MESSAGE, string(opt.payload, 'x'));
+        return true;
+    }
+
+    ifstream file;
+    bool from_stdin = strcmp(opt.request_file, "-") == 0;
+    if (!from_stdin)
+        file.open(opt.request_file);
+    istream &lines = from_stdin ? cin : file;
+    if (!lines) {
+        cerr << "Cannot read " << opt.request_file << "\n";
+        return false;
+    }
+    string line;
+    while (getline(lines, line)) {
+        if (line.size() + 1 > MAX_FRAME_SIZE) {
+            cerr << "Request too long: " << line.size() << " bytes\n";
+            return false;
+        }
+        source.frames.emplace_back();
+        append_frame(source.frames.back(), OP_MESSAGE, line);
+    }
+    if (source.frames.empty()) {
+        cerr << "No requests in " << opt.request_file << "\n";
+        return false;
+    }
+    return true;
+}
+
+// A run of queued output: `len` bytes of a frame owned by the
+// RequestSource, or, with data == nullptr, the next `len` bytes of the
+// connection's `staged` copies.
+struct OutSegment {
+    const char *data;
+    size_t len;
+};
+
+struct LoadConnection {
+    int fd;
+    string in;
+    string staged;                  // small requests, copied back to back
+    deque<OutSegment> out;          // everything queued, in send order
+    deque<uint64_t> intended_ns;    // schedule time of each outstanding request
+    deque<uint64_t> sent_ns;        // actual send time of each outstanding request
+    uint64_t next_ns = 0;           // open loop: when the next request is due
+    bool want_write = false;
+};
+
+static uint64_t now_ns() {
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Write the queued segments, up to WRITEV_BATCH per writev, until the
+// queue is empty or the socket is full.
+static bool flush_output(int epfd, LoadConnection &conn) {
+    while (!conn.out.empty()) {
+        struct iovec iov[WRITEV_BATCH];
+        int count = 0;
+        size_t total = 0, staged = 0;
+        for (auto it = conn.out.begin(); it != conn.out.end() && count < WRITEV_BATCH; ++it, ++count) {
+            iov[count].iov_base = (void *)(it->data ? it->data : conn.staged.data() + staged);
+            iov[count].iov_len = it->len;
+            if (!it->data)
+                staged += it->len;
+            total += it->len;
+        }
+        ssize_t n = writev(conn.fd, iov, count);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            return false;
+        }
+        size_t left = n;
+        staged = 0;
+        while (left > 0) {
+            OutSegment &seg = conn.out.front();
+            size_t done = min(left, seg.len);
+            if (seg.data)
+                seg.data += done;
+            else
+                staged += done;
+            seg.len -= done;
+            left -= done;
+            if (seg.len == 0)
+                conn.out.pop_front();
+        }
+        conn.staged.erase(0, staged);
+        if ((size_t)n < total)
+            break;
+    }
+
+    bool want_write = !conn.out.empty();
+    if (want_write != conn.want_write) {
+        struct epoll_event ev;
+        ev.events = EPOLLIN | (want_write ? (uint32_t)EPOLLOUT : 0u);
+        ev.data.ptr = &conn;
+        epoll_ctl(epfd, EPOLL_CTL_MOD, conn.fd, &ev);
+        conn.want_write = want_write;
+    }
+    return true;
+}
+
+static void queue_request(LoadConnection &conn, const string &request, uint64_t intended, uint64_t now) {
+    if (request.size() >= WRITEV_COPY_MAX) {
+        conn.out.push_back({request.data(), request.size()});
+    } else {
+        if (conn.out.empty() || conn.out.back().data)
+            conn.out.push_back({nullptr, 0});
+        conn.out.back().len += request.size();
+        conn.staged += request;
+    }
+    conn.intended_ns.push_back(intended);
+    conn.sent_ns.push_back(now);
+}
+
+static void print_latency(const char *label, const Histogram &h) {
+    cout << setw(12) << left << label << right << fixed << setprecision(1)
+         << setw(10) << h.percentile(50) / 1e3
+         << setw(10) << h.percentile(90) / 1e3
+         << setw(10) << h.percentile(99) / 1e3
+         << setw(10) << h.percentile(99.9) / 1e3
+         << setw(10) << h.max / 1e3 << "\n";
+}
+
+static int run_load(const struct sockaddr_in &serv_addr, const LoadOptions &opt) {
+    RequestSource source;
+    if (!load_requests(opt, source))
+        return -1;
+
+    int epfd = epoll_create1(0);
+    vector<LoadConnection> conns(opt.connections);
+    for (LoadConnection &conn : conns) {
+        conn.fd = connect_to(serv_addr);
+        if (conn.fd < 0)
+            return -1;
+        int one = 1;
+        setsockopt(conn.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        fcntl(conn.fd, F_SETFL, fcntl(conn.fd, F_GETFL) | O_NONBLOCK);
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = &conn;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, conn.fd, &ev);
+    }
+    if (socket_buffers.bytes > 0)
+        print_socket_buffers(conns[0].fd, socket_buffers);
+
+    bool open_loop = opt.rate > 0;
+    // Each connection carries an equal share of the rate, phase-shifted so
+    // the connections do not fire in lockstep.
+    uint64_t interval = open_loop ? (uint64_t)(1e9 * opt.connections / opt.rate) : 0;
+    uint64_t start = now_ns();
+    uint64_t end = source.once ? UINT64_MAX : start + (uint64_t)(opt.duration * 1e9);
+    for (size_t i = 0; i < conns.size(); i++) {
+        LoadConnection &conn = conns[i];
+        if (open_loop) {
+            conn.next_ns = start + interval * i / conns.size();
+        } else {
+            for (int k = 0; k < opt.inflight && !source.exhausted(); k++)
+                queue_request(conn, source.take(), start, start);
+            flush_output(epfd, conn);
+        }
+    }
+
+    Histogram corrected, uncorrected;
+    uint64_t completed = 0;
+    char buffer[BUFFER_SIZE];
+    struct epoll_event events[MAX_EVENTS];
+    uint64_t now = start;
+    while (now < end && !(source.once && completed == source.frames.size())) {
+        int timeout_ms = 100;
+        if (open_loop) {
+            // Send everything that is due, then sleep until the next slot
+            // (or spin when it is less than a millisecond away).
+            uint64_t next = end;
+            for (LoadConnection &conn : conns) {
+                bool queued = false;
+                while (conn.next_ns <= now) {
+                    if (source.exhausted()) {
+                        conn.next_ns = end;
+                        break;
+                    }
+                    queue_request(conn, source.take(), conn.next_ns, now);
+                    conn.next_ns += interval;
+                    queued = true;
+                }
+                if (queued && !flush_output(epfd, conn)) {
+                    cerr << "Connection lost\n";
+                    return -1;
+                }
+                if (conn.next_ns < next)
+                    next = conn.next_ns;
+            }
+            timeout_ms = next > now ? (int)min<uint64_t>((next - now) / 1000000, 100) : 0;
+        }
+
+        int n = epoll_wait(epfd, events, MAX_EVENTS, timeout_ms);
+        now = now_ns();
+        for (int i = 0; i < n; i++) {
+            LoadConnection &conn = *(LoadConnection *)events[i].data.ptr;
+            if ((events[i].events & EPOLLOUT) && !flush_output(epfd, conn)) {
+                cerr << "Connection lost\n";
+                return -1;
+            }
+            if (!(events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)))
+                continue;
+
+            ssize_t valread = read(conn.fd, buffer, BUFFER_SIZE);
+            if (valread <= 0) {
+                if (valread < 0 && (errno == EAGAIN || errno == EINTR))
+                    continue;
+                cerr << "Connection lost\n";
+                return -1;
+            }
+            conn.in.append(buffer, valread);
+
+            size_t used = 0;
+            Frame frame;
+            long len;
+            int replies = 0;
+            while ((len = parse_frame(conn.in.data() + used, conn.in.size() - used, frame)) > 0) {
+                used += len;
+                replies++;
+                corrected.record(now - conn.intended_ns.front());
+                uncorrected.record(now - conn.sent_ns.front());
+                conn.intended_ns.pop_front();
+                conn.sent_ns.pop_front();
+            }
+            if (len < 0) {
+                cerr << "Malformed reply\n";
+                return -1;
+            }
+            conn.in.erase(0, used);
+            completed += replies;
+
+            if (!open_loop && replies > 0) {
+                for (int k = 0; k < replies && !source.exhausted(); k++)
+                    queue_request(conn, source.take(), now, now);
+                if (!flush_output(epfd, conn)) {
+                    cerr << "Connection lost\n";
+                    return -1;
+                }
+            }
+        }
+    }
+    double elapsed = (now - start) / 1e9;
+
+    for (LoadConnection &conn : conns)
+        close(conn.fd);
+    close(epfd);
+
+    cout << (open_loop ? "open loop" : "closed loop") << ", " << opt.connections << " connection(s), ";
+    if (open_loop)
+        cout << "target " << opt.rate << " req/s";
+    else
+        cout << opt.inflight << " in flight per connection";
+    if (opt.request_file)
+        cout << ", " << (source.once ? "each of " : "cycling ") << source.frames.size()
+             << " request(s) from " << opt.request_file << "\n";
+    else
+        cout << ", " << opt.payload << " byte payload\n";
+    cout << "requests " << completed << " in " << fixed << setprecision(2) << elapsed << " s, throughput "
+         << setprecision(1) << completed / elapsed << " req/s\n";
+    cout << setw(12) << left << "latency(us)" << right << setw(10) << "p50" << setw(10) << "p90"
+         << setw(10) << "p99" << setw(10) << "p99.9" << setw(10) << "max" << "\n";
+    if (open_loop) {
+        print_latency("corrected", corrected);
+        print_latency("uncorrected", uncorrected);
+    } else {
+        print_latency("", uncorrected);
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// UDP (-u)
+//
+// One request per datagram, tagged with a per-socket sequence number that
+// the server echoes. Nothing is retransmitted: a reply that never comes
+// is counted as lost, and one whose sequence number is below a reply
+// already seen on the same socket as reordered. Requests go out with
+// sendmmsg and replies are read with recvmmsg; -g merges the requests of
+// one socket into GSO sends and enables GRO on receive.
+// ---------------------------------------------------------------------------
+
+static int udp_connect(const struct sockaddr_in &serv_addr, bool gro) {
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0) {
+        cerr << "Socket creation error\n";
+        return -1;
+    }
+    int one = 1;
+    if (gro && setsockopt(sock, SOL_UDP, UDP_GRO, &one, sizeof(one)) < 0) {
+        cerr << "UDP_GRO not supported: " << strerror(errno) << "\n";
+        close(sock);
+        return -1;
+    }
+    // A connected UDP socket only accepts datagrams from the server.
+    if (connect(sock, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0) {
+        cerr << "Connection failed\n";
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+// Frame a request datagram around `text`; the sequence number is patched
+// in at `seq_offset` before each send.
+static string udp_request(const string &text, size_t &seq_offset) {
+    string payload(DGRAM_SEQ_BYTES, '\0');
+    payload += text;
+    string request;
+    append_frame(request, OP_DGRAM_MESSAGE, payload);
+    seq_offset = request.size() - payload.size();
+    return request;
+}
+
+// Parse one reply datagram. Returns false unless it is exactly one
+// OP_DGRAM_REPLY frame.
+static bool udp_reply(const char *buf, size_t len, uint64_t &seq, Frame &frame) {
+    long n = parse_frame(buf, len, frame);
+    if (n <= 0 || (size_t)n != len || frame.opcode != OP_DGRAM_REPLY || frame.length < DGRAM_SEQ_BYTES)
+        return false;
+    seq = decode_seq(frame.payload);
+    return true;
+}
+
+static int run_udp_interactive(const struct sockaddr_in &serv_addr) {
+    int sock = udp_connect(serv_addr, false);
+    if (sock < 0)
+        return -1;
+    struct timeval tv = {UDP_REPLY_TIMEOUT_MS / 1000, (UDP_REPLY_TIMEOUT_MS % 1000) * 1000};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    cout << "Sending datagrams to server\n";
+
+    char buffer[UDP_MAX_DATAGRAM];
+    for (uint64_t seq = 0;; seq++) {
+        string message;
+        cout << "Enter your message: ";
+        if (!getline(cin, message))
+            break;
+
+        size_t seq_offset;
+        string request = udp_request(message, seq_offset);
+        if (request.size() > UDP_MAX_DATAGRAM) {
+            cerr << "Message does not fit in one datagram\n";
+            continue;
+        }
+        encode_seq(seq, &request[seq_offset]);
+        send(sock, request.data(), request.size(), 0);
+
+        // Skip stale replies to earlier, timed-out requests.
+        string reply;
+        bool answered = false;
+        while (!answered) {
+            ssize_t n = recv(sock, buffer, sizeof(buffer), 0);
+            if (n < 0)
+                break;
+            uint64_t reply_seq;
+            Frame frame;
+            if (udp_reply(buffer, n, reply_seq, frame) && reply_seq == seq) {
+                reply.assign(frame.payload + DGRAM_SEQ_BYTES, frame.length - DGRAM_SEQ_BYTES);
+                answered = true;
+            }
+        }
+        if (!answered) {
+            cout << "No reply (datagram lost?)\n";
+            continue;
+        }
+
+        cout << "Server replied: " << reply << "\n";
+        if (message == "Quit" && reply == "Goodbye") {
+            cout << "Exiting...\n";
+            break;
+        }
+    }
+
+    close(sock);
+    return 0;
+}
+
+struct UdpFlow {
+    int fd;
+    uint64_t next_seq = 0;
+    uint64_t highest = 0;           // one past the highest sequence number answered
+    uint64_t outstanding = 0;       // closed loop: requests not answered or given up on
+    uint64_t last_activity_ns = 0;  // closed loop: last reply or refill
+    uint64_t next_ns = 0;           // open loop: when the next request is due
+    vector<uint64_t> intended_ns;   // by sequence number % UDP_SEQ_WINDOW
+    vector<uint64_t> sent_ns;
+};
+
+struct UdpTotals {
+    uint64_t sent = 0, received = 0, reordered = 0;
+};
+
+static void udp_queue_request(UdpFlow &flow, UdpSendBatch &out, string &request, size_t seq_offset,
+                              uint64_t intended, uint64_t now, UdpTotals &totals) {
+    char *slot = udp_send_slot(out, nullptr, request.size());
+    if (!slot) {
+        udp_send_flush(flow.fd, out);
+        slot = udp_send_slot(out, nullptr, request.size());
+    }
+    uint64_t seq = flow.next_seq++;
+    encode_seq(seq, &request[seq_offset]);
+    memcpy(slot, request.data(), request.size());
+    flow.intended_ns[seq % UDP_SEQ_WINDOW] = intended;
+    flow.sent_ns[seq % UDP_SEQ_WINDOW] = now;
+    totals.sent++;
+}
+
+// Closed loop: top the socket back up to `inflight` outstanding requests.
+static void udp_refill(UdpFlow &flow, UdpSendBatch &out, string &request, size_t seq_offset,
+                       int inflight, uint64_t now, UdpTotals &totals) {
+    for (; flow.outstanding < (uint64_t)inflight; flow.outstanding++)
+        udp_queue_request(flow, out, request, seq_offset, now, now, totals);
+    udp_send_flush(flow.fd, out);
+    flow.last_activity_ns = now;
+}
+
+// Read every reply waiting on the socket. Returns how many arrived.
+static uint64_t udp_receive(UdpFlow &flow, UdpRecvBatch &in, uint64_t now, UdpTotals &totals,
+                            Histogram &corrected, Histogram &uncorrected) {
+    uint64_t replies = 0;
+    while (true) {
+        int n = udp_recv(flow.fd, in, MSG_DONTWAIT);
+        if (n <= 0)
+            break;
+        for (int i = 0; i < n; i++) {
+            udp_for_each_datagram(in, i, [&](const char *buf, size_t len) {
+                uint64_t seq;
+                Frame frame;
+                if (!udp_reply(buf, len, seq, frame) || seq >= flow.next_seq)
+                    return;
+                if (flow.next_seq - seq <= UDP_SEQ_WINDOW) {
+                    corrected.record(now - flow.intended_ns[seq % UDP_SEQ_WINDOW]);
+                    uncorrected.record(now - flow.sent_ns[seq % UDP_SEQ_WINDOW]);
+                }
+                if (seq < flow.highest)
+                    totals.reordered++;
+                else
+                    flow.highest = seq + 1;
+                replies++;
+            });
+        }
+        if (n < UDP_BATCH)
+            break;
+    }
+    totals.received += replies;
+    return replies;
+}
+
+static int run_udp_load(const struct sockaddr_in &serv_addr, const LoadOptions &opt, bool offload) {
+    size_t seq_offset;
+    string request = udp_request(string(opt.payload, 'x'), seq_offset);
+    if (request.size() > UDP_MAX_DATAGRAM) {
+        cerr << "Payload does not fit in one datagram\n";
+        return -1;
+    }
+
+    int epfd = epoll_create1(0);
+    vector<UdpFlow> flows(opt.connections);
+    for (UdpFlow &flow : flows) {
+        flow.fd = udp_connect(serv_addr, offload);
+        if (flow.fd < 0)
+            return -1;
+        fcntl(flow.fd, F_SETFL, fcntl(flow.fd, F_GETFL) | O_NONBLOCK);
+        flow.intended_ns.resize(UDP_SEQ_WINDOW);
+        flow.sent_ns.resize(UDP_SEQ_WINDOW);
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = &flow;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, flow.fd, &ev);
+    }
+
+    UdpRecvBatch in;
+    UdpSendBatch out;
+    udp_recv_init(in, offload ? UDP_GRO_SLOT : UDP_MAX_DATAGRAM);
+    udp_send_init(out, offload);
+    UdpTotals totals;
+
+    bool open_loop = opt.rate > 0;
+    uint64_t interval = open_loop ? (uint64_t)(1e9 * opt.connections / opt.rate) : 0;
+    uint64_t start = now_ns();
+    uint64_t end = start + (uint64_t)(opt.duration * 1e9);
+    for (size_t i = 0; i < flows.size(); i++) {
+        if (open_loop)
+            flows[i].next_ns = start + interval * i / flows.size();
+        else
+            udp_refill(flows[i], out, request, seq_offset, opt.inflight, start, totals);
+    }
+
+    // After `end` nothing more is sent; replies are collected for another
+    // UDP_DRAIN_NS so that slow ones are not miscounted as lost.
+    Histogram corrected, uncorrected;
+    struct epoll_event events[MAX_EVENTS];
+    uint64_t now = start;
+    while (now < end || (now < end + UDP_DRAIN_NS && totals.received < totals.sent)) {
+        bool sending = now < end;
+        int timeout_ms = 10;
+        if (sending && open_loop) {
+            uint64_t next = end;
+            for (UdpFlow &flow : flows) {
+                bool queued = false;
+                while (flow.next_ns <= now) {
+                    udp_queue_request(flow, out, request, seq_offset, flow.next_ns, now, totals);
+                    flow.next_ns += interval;
+                    queued = true;
+                }
+                if (queued)
+                    udp_send_flush(flow.fd, out);
+                if (flow.next_ns < next)
+                    next = flow.next_ns;
+            }
+            timeout_ms = next > now ? (int)((next - now) / 1000000) : 0;
+        } else if (sending) {
+            // A window whose replies were all lost would stall forever.
+            for (UdpFlow &flow : flows) {
+                if (flow.outstanding > 0 && now - flow.last_activity_ns > UDP_LOSS_TIMEOUT_NS) {
+                    flow.outstanding = 0;
+                    udp_refill(flow, out, request, seq_offset, opt.inflight, now, totals);
+                }
+            }
+        }
+
+        int n = epoll_wait(epfd, events, MAX_EVENTS, timeout_ms);
+        now = now_ns();
+        for (int i = 0; i < n; i++) {
+            UdpFlow &flow = *(UdpFlow *)events[i].data.ptr;
+            uint64_t replies = udp_receive(flow, in, now, totals, corrected, uncorrected);
+            if (!open_loop && replies > 0 && now < end) {
+                flow.outstanding -= min(replies, flow.outstanding);
+                udp_refill(flow, out, request, seq_offset, opt.inflight, now, totals);
+            }
+        }
+    }
+    double elapsed = (min(now, end) - start) / 1e9;
+
+    for (UdpFlow &flow : flows)
+        close(flow.fd);
+    close(epfd);
+
+    uint64_t lost = totals.sent > totals.received ? totals.sent - totals.received : 0;
+    cout << "UDP " << (open_loop ? "open loop" : "closed loop") << ", " << opt.connections << " socket(s), ";
+    if (open_loop)
+        cout << "target " << opt.rate << " req/s";
+    else
+        cout << opt.inflight << " in flight per socket";
+    cout << ", " << opt.payload << " byte payload" << (offload ? ", GSO/GRO" : "") << "\n";
+    cout << "sent " << totals.sent << ", received " << totals.received << " in " << fixed << setprecision(2)
+         << elapsed << " s, " << setprecision(1) << totals.sent / elapsed << " pkt/s out, "
+         << totals.received / elapsed << " pkt/s in\n";
+    cout << "lost " << lost << " (" << setprecision(3) << (totals.sent ? 100.0 * lost / totals.sent : 0)
+         << "%), reordered " << totals.reordered << " ("
+         << (totals.received ? 100.0 * totals.reordered / totals.received : 0) << "%)\n";
+    cout << setw(12) << left << "latency(us)" << right << setw(10) << "p50" << setw(10) << "p90"
+         << setw(10) << "p99" << setw(10) << "p99.9" << setw(10) << "max" << "\n";
+    if (open_loop) {
+        print_latency("corrected", corrected);
+        print_latency("uncorrected", uncorrected);
+    } else {
+        print_latency("", uncorrected);
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Shared memory (-m)
+//
+// The same request/reply stream as over TCP, through a ring pair set up by
+// the server's Unix socket (shmring.h). Reads block in the ring, so the
+// load generator runs one thread per connection, closed loop only.
+// ---------------------------------------------------------------------------
+
+struct ShmConnection {
+    int sock = -1;
+    ShmChannel *channel = nullptr;
+    ShmSpin spin;
+};
+
+static bool shm_open(const char *path, ShmConnection &conn) {
+    conn.channel = shm_connect(path, conn.sock);
+    if (!conn.channel) {
+        cerr << "Cannot connect to " << path << ": " << strerror(errno) << "\n";
+        return false;
+    }
+    return true;
+}
+
+static void shm_close(ShmConnection &conn) {
+    shm_ring_close(conn.channel->requests);
+    shm_ring_close(conn.channel->replies);
+    shm_unmap(conn.channel);
+    close(conn.sock);
+}
+
+static bool shm_send(ShmConnection &conn, const string &out) {
+    size_t sent = 0;
+    while (sent < out.size()) {
+        long n = shm_ring_write(conn.channel->requests, conn.spin, out.data() + sent, out.size() - sent,
+                                SHM_IDLE_CHECK_MS);
+        if (n < 0 || (n == 0 && shm_peer_gone(conn.sock)))
+            return false;
+        sent += n;
+    }
+    return true;
+}
+
+// Append whatever replies arrive next to `in`; false if the server is gone.
+static bool shm_receive(ShmConnection &conn, string &in) {
+    char buffer[BUFFER_SIZE];
+    while (true) {
+        long n = shm_ring_read(conn.channel->replies, conn.spin, buffer, BUFFER_SIZE, SHM_IDLE_CHECK_MS);
+        if (n > 0) {
+            in.append(buffer, n);
+            return true;
+        }
+        if (n < 0 || shm_peer_gone(conn.sock))
+            return false;
+    }
+}
+
+static int run_shm_interactive(const char *path) {
+    ShmConnection conn;
+    if (!shm_open(path, conn))
+        return -1;
+    cout << "Connected to server through shared memory\n";
+
+    string in, out, reply;
+    while (true) {
+        string message;
+        cout << "Enter your message: ";
+        if (!getline(cin, message))
+            break;
+
+        out.clear();
+        append_frame(out, OP_MESSAGE, message);
+        Frame frame;
+        long n = 0;
+        bool ok = shm_send(conn, out);
+        while (ok && (n = parse_frame(in.data(), in.size(), frame)) == 0)
+            ok = shm_receive(conn, in);
+        if (!ok || n < 0 || frame.opcode != OP_REPLY) {
+            cerr << "Connection lost\n";
+            break;
+        }
+        reply.assign(frame.payload, frame.length);
+        in.erase(0, n);
+
+        cout << "Server replied: " << reply << "\n";
+        if (message == "Quit" && reply == "Goodbye") {
+            cout << "Exiting...\n";
+            break;
+        }
+    }
+
+    shm_close(conn);
+    return 0;
+}
+
+struct ShmLoadResult {
+    Histogram latency;
+    uint64_t completed = 0;
+    uint64_t syscalls = 0;
+    bool failed = false;
+};
+
+// One closed-loop connection: keep opt.inflight requests outstanding
+// until `end`.
+static void shm_load_connection(ShmConnection &conn, const LoadOptions &opt, const string &request,
+                                uint64_t end, ShmLoadResult &result) {
+    deque<uint64_t> sent_ns;
+    string in, out;
+    uint64_t now = now_ns();
+    for (int k = 0; k < opt.inflight; k++) {
+        out += request;
+        sent_ns.push_back(now);
+    }
+
+    while (now < end) {
+        if (!shm_send(conn, out) || !shm_receive(conn, in)) {
+            result.failed = true;
+            break;
+        }
+        out.clear();
+        now = now_ns();
+
+        size_t used = 0;
+        Frame frame;
+        long len;
+        while ((len = parse_frame(in.data() + used, in.size() - used, frame)) > 0) {
+            used += len;
+            result.latency.record(now - sent_ns.front());
+            sent_ns.pop_front();
+            result.completed++;
+            out += request;
+            sent_ns.push_back(now);
+        }
+        if (len < 0) {
+            result.failed = true;
+            break;
+        }
+        in.erase(0, used);
+    }
+    result.syscalls = conn.spin.syscalls;
+}
+
+static int run_shm_load(const char *path, const LoadOptions &opt) {
+    if (opt.rate > 0) {
+        cerr << "Open-loop load (-r) needs TCP\n";
+        return 1;
+    }
+    vector<ShmConnection> conns(opt.connections);
+    for (ShmConnection &conn : conns)
+        if (!shm_open(path, conn))
+            return -1;
+
+    string request;
+    append_frame(request, OP_MESSAGE, string(opt.payload, 'x'));
+
+    vector<ShmLoadResult> results(opt.connections);
+    vector<thread> threads;
+    uint64_t start = now_ns();
+    uint64_t end = start + (uint64_t)(opt.duration * 1e9);
+    for (int i = 0; i < opt.connections; i++)
+        threads.emplace_back(shm_load_connection, ref(conns[i]), cref(opt), cref(request), end,
+                             ref(results[i]));
+    for (thread &t : threads)
+        t.join();
+    double elapsed = (now_ns() - start) / 1e9;
+
+    Histogram latency;
+    uint64_t completed = 0, syscalls = 0;
+    for (int i = 0; i < opt.connections; i++) {
+        if (results[i].failed) {
+            cerr << "Connection lost\n";
+            return -1;
+        }
+        latency.merge(results[i].latency);
+        completed += results[i].completed;
+        syscalls += results[i].syscalls;
+        shm_close(conns[i]);
+    }
+
+    cout << "closed loop, " << opt.connections << " shared-memory connection(s), " << opt.inflight
+         << " in flight per connection, " << opt.payload << " byte payload\n";
+    cout << "requests " << completed << " in " << fixed << setprecision(2) << elapsed << " s, throughput "
+         << setprecision(1) << completed / elapsed << " req/s\n";
+    cout << "futex syscalls " << syscalls << " (" << setprecision(3)
+         << (completed ? (double)syscalls / completed : 0) << " per request)\n";
+    cout << setw(12) << left << "latency(us)" << right << setw(10) << "p50" << setw(10) << "p90"
+         << setw(10) << "p99" << setw(10) << "p99.9" << setw(10) << "max" << "\n";
+    print_latency("", latency);
+    return 0;
+}
+
+static double cpu_seconds() {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+// Ask the server for `bytes` of bulk data (0 = its default) and receive
+// the raw stream into one large buffer that is reused for every read.
+static int run_bulk(int sock, uint64_t bytes) {
+    string in, out, header;
+    append_varint_frame(out, OP_BULK_REQUEST, bytes);
+
+    auto start = chrono::steady_clock::now();
+    double cpu_start = cpu_seconds();
+    send(sock, out.data(), out.size(), 0);
+
+    uint8_t opcode;
+    uint64_t total;
+    if (!read_frame(sock, in, opcode, header) || opcode != OP_BULK_START ||
+        decode_varint(header.data(), header.size(), total) <= 0) {
+        cerr << "Bad bulk reply\n";
+        return -1;
+    }
+
+    // read_frame may already have pulled in the first bytes of the stream.
+    uint64_t received = min<uint64_t>(in.size(), total);
+    char *buffer = new char[BULK_BUFFER_SIZE];
+    while (received < total) {
+        ssize_t n = recv(sock, buffer, (size_t)min<uint64_t>(BULK_BUFFER_SIZE, total - received), 0);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR)
+                continue;
+            cerr << "Connection lost after " << received << " of " << total << " bytes\n";
+            delete[] buffer;
+            return -1;
+        }
+        received += n;
+    }
+    delete[] buffer;
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    double cpu = cpu_seconds() - cpu_start;
+    double gb = total / 1e9;
+    cout << "received " << total << " bytes in " << fixed << setprecision(3) << seconds << " s: "
+         << setprecision(1) << gb / seconds * 1e3 << " MB/s (" << gb * 8 / seconds << " Gbit/s), "
+         << setprecision(3) << (gb > 0 ? cpu / gb : 0) << " CPU s/GB\n";
+    if (socket_buffers.mbps > 0) {
+        double achieved = gb * 8e3 / seconds;
+        cout << "achieved " << setprecision(1) << achieved << " of " << socket_buffers.mbps
+             << " Mbit/s theoretical (" << achieved / socket_buffers.mbps * 100 << "%)\n";
+    }
+    close(sock);
+    return 0;
+}
+
+// Print the counters a server publishes on its metrics socket (server -s).
+static int print_server_metrics(const char *path) {
+    int fd = unix_connect(path);
+    if (fd < 0) {
+        cerr << "Cannot connect to " << path << ": " << strerror(errno) << "\n";
+        return 1;
+    }
+    char buffer[4096];
+    ssize_t n;
+    while ((n = read(fd, buffer, sizeof(buffer))) > 0)
+        cout.write(buffer, n);
+    close(fd);
+    return 0;
+}
+
+static void usage(const char *prog) {
+    cerr << "Usage: " << prog << " [-h host] [-p port]                       interactive\n"
+         << "       " << prog << " -l [-h host] [-p port] [-c connections] [-r rate | -i inflight]\n"
+         << "          [-s payload_bytes | -F file] [-d seconds]                load generator\n"
+         << "       " << prog << " -F file [-c connections] [-i inflight | -r rate]   send every line once\n"
+         << "       " << prog << " -B bytes [-h host] [-p port]              bulk download\n"
+         << "       -w bytes|mbps:rtt_ms sets TCP socket buffers (mbps:rtt_ms sizes them from the\n"
+         << "       bandwidth-delay product)\n"
+         << "       -u sends requests as UDP datagrams (interactive or -l; -c is then the\n"
+         << "       number of sockets), -g adds UDP GSO/GRO\n"
+         << "       -m path talks to a server on this host through shared memory, set up via\n"
+         << "       its Unix socket at path (interactive or closed-loop -l)\n"
+         << "       " << prog << " -S path                                 server metrics (server -s)\n";
+}
+
+int main(int argc, char *argv[]) {
+    const char *host = "127.0.0.1";
+    int port = PORT;
+    bool load = false;
+    long long bulk_bytes = -1;
+    bool udp = false, udp_offload = false;
+    const char *shm_path = nullptr;
+    const char *metrics_path = nullptr;
+    LoadOptions load_opt;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "h:p:lc:r:i:s:d:B:w:ugm:S:F:")) != -1) {
+        switch (opt) {
+        case 'h': host = optarg; break;
+        case 'p': port = atoi(optarg); break;
+        case 'l': load = true; break;
+        case 'c': load_opt.connections = atoi(optarg); break;
+        case 'r': load_opt.rate = atof(optarg); break;
+        case 'i': load_opt.inflight = atoi(optarg); break;
+        case 's': load_opt.payload = atol(optarg); break;
+        case 'd': load_opt.duration = atof(optarg); break;
+        case 'B': bulk_bytes = atoll(optarg); break;
+        case 'w':
+            if (!parse_socket_buffer(optarg, socket_buffers)) {
+                cerr << "Bad socket buffer " << optarg << " (expected BYTES or MBPS:RTT_MS)\n";
+                return 1;
+            }
+            break;
+        case 'u': udp = true; break;
+        case 'g': udp_offload = true; break;
+        case 'm': shm_path = optarg; break;
+        case 'S': metrics_path = optarg; break;
+        case 'F': load_opt.request_file = optarg; break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (load_opt.connections < 1 || load_opt.inflight < 1 || load_opt.payload + 1 > MAX_FRAME_SIZE) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (metrics_path)
+        return print_server_metrics(metrics_path);
+    if (load_opt.request_file) {
+        if (udp || shm_path || bulk_bytes >= 0) {
+            cerr << "-F drives the TCP load generator only\n";
+            return 1;
+        }
+        load_opt.batch = !load;
+        load = true;
+    }
+
+    if (shm_path) {
+        if (udp || bulk_bytes >= 0) {
+            cerr << "Shared memory carries interactive and -l requests only\n";
+            return 1;
+        }
+        return load ? run_shm_load(shm_path, load_opt) : run_shm_interactive(shm_path);
+    }
+
+    struct sockaddr_in serv_addr;
+    memset(&serv_addr, 0, sizeof(serv_addr));
+    serv_addr.sin_family = AF_INET;
+    serv_addr.sin_port = htons(port);
+
+    // Convert IPv4 and IPv6 addresses from text to binary form
+    if (inet_pton(AF_INET, host, &serv_addr.sin_addr) <= 0) {
+         cerr << "Invalid address/ Address not supported\n";
+        return -1;
+    }
+
+    if (udp && bulk_bytes >= 0) {
+        cerr << "Bulk transfers need TCP\n";
+        return 1;
+    }
+    if (udp)
+        return load ? run_udp_load(serv_addr, load_opt, udp_offload) : run_udp_interactive(serv_addr);
+
+    if (load) {
+        signal(SIGPIPE, SIG_IGN);
+        return run_load(serv_addr, load_opt);
+    }
+
+    int sock = connect_to(serv_addr);
+    if (sock < 0)
+        return -1;
+    if (socket_buffers.bytes > 0)
+        print_socket_buffers(sock, socket_buffers);
+    if (bulk_bytes >= 0)
+        return run_bulk(sock, (uint64_t)bulk_bytes);
+    return run_interactive(sock);
+}
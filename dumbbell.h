@@ -0,0 +1,124 @@
+// Dumbbell (fan-in) topology for the ns-3 scenarios: `senders` nodes on the
+// left and `receivers` nodes on the right, each behind its own access link,
+// with every left-to-right packet crossing one bottleneck link between two
+// routers. The bottleneck queue disc sits on the left router's egress.
+// Global routing is populated, so applications can be installed as soon as
+// the topology exists.
+//
+// For distributed runs (ns-3 built with MPI) the nodes are spread over
+// `partitions` ranks and every cut falls on a point-to-point link, which
+// PointToPointHelper then turns into a remote channel: the left router on
+// the first rank, the right router on the last, senders and receivers in
+// contiguous blocks over all ranks. Every rank builds the whole topology;
+// install applications only on nodes for which IsLocal() holds.
+#ifndef DUMBBELL_H
+#define DUMBBELL_H
+
+#include "ns3/core-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/network-module.h"
+#include "ns3/point-to-point-module.h"
+#ifdef NS3_MPI
+#include "ns3/mpi-interface.h"
+#endif
+
+#include <string>
+#include <vector>
+
+#include "bottleneck.h"
+
+#define DUMBBELL_MAX_LEAVES 16384   // senders or receivers: /30 links in a /16
+
+struct DumbbellConfig
+{
+    uint32_t senders = 1;
+    uint32_t receivers = 1;
+    std::string accessRate = "100Mbps";
+    std::string accessDelay = "1ms";
+    std::string bottleneckRate = "10Mbps";
+    std::string bottleneckDelay = "20ms";
+    std::string queueDisc = "default";   // see bottleneck.h
+    uint32_t partitions = 1;             // MPI ranks the nodes are spread over
+};
+
+class DumbbellTopology
+{
+  public:
+    explicit DumbbellTopology(const DumbbellConfig &config)
+    {
+        uint32_t last = config.partitions - 1;
+        m_routers.Create(1, 0);
+        m_routers.Create(1, last);
+        for (uint32_t i = 0; i < config.senders; i++)
+        {
+            m_senders.Create(1, (uint64_t)i * config.partitions / config.senders);
+        }
+        for (uint32_t i = 0; i < config.receivers; i++)
+        {
+            m_receivers.Create(1, (uint64_t)i * config.partitions / config.receivers);
+        }
+
+        ns3::InternetStackHelper stack;
+        stack.Install(m_routers);
+        stack.Install(m_senders);
+        stack.Install(m_receivers);
+
+        ns3::PointToPointHelper bottleneck;
+        bottleneck.SetDeviceAttribute("DataRate", ns3::StringValue(config.bottleneckRate));
+        bottleneck.SetChannelAttribute("Delay", ns3::StringValue(config.bottleneckDelay));
+        ns3::NetDeviceContainer routerDevices = bottleneck.Install(m_routers);
+        m_bottleneck = routerDevices.Get(0);
+        InstallBottleneckQueue(m_bottleneck, config.queueDisc);
+
+        // One /30 per link: each side has room for DUMBBELL_MAX_LEAVES leaves
+        ns3::Ipv4AddressHelper routerAddresses("10.3.0.0", "255.255.255.252");
+        routerAddresses.Assign(routerDevices);
+        FinishBottleneckQueue(m_bottleneck, config.queueDisc);
+
+        ns3::PointToPointHelper access;
+        access.SetDeviceAttribute("DataRate", ns3::StringValue(config.accessRate));
+        access.SetChannelAttribute("Delay", ns3::StringValue(config.accessDelay));
+        ns3::Ipv4AddressHelper senderAddresses("10.1.0.0", "255.255.255.252");
+        for (uint32_t i = 0; i < config.senders; i++)
+        {
+            ns3::NetDeviceContainer link = access.Install(m_senders.Get(i), m_routers.Get(0));
+            m_senderAddresses.push_back(senderAddresses.Assign(link).GetAddress(0));
+            senderAddresses.NewNetwork();
+        }
+        ns3::Ipv4AddressHelper receiverAddresses("10.2.0.0", "255.255.255.252");
+        for (uint32_t i = 0; i < config.receivers; i++)
+        {
+            ns3::NetDeviceContainer link = access.Install(m_receivers.Get(i), m_routers.Get(1));
+            m_receiverAddresses.push_back(receiverAddresses.Assign(link).GetAddress(0));
+            receiverAddresses.NewNetwork();
+        }
+
+        ns3::Ipv4GlobalRoutingHelper::PopulateRoutingTables();
+    }
+
+    uint32_t Senders() const { return m_senders.GetN(); }
+    uint32_t Receivers() const { return m_receivers.GetN(); }
+    ns3::Ptr<ns3::Node> Sender(uint32_t i) const { return m_senders.Get(i); }
+    ns3::Ptr<ns3::Node> Receiver(uint32_t i) const { return m_receivers.Get(i); }
+    ns3::Ipv4Address SenderAddress(uint32_t i) const { return m_senderAddresses[i]; }
+    ns3::Ipv4Address ReceiverAddress(uint32_t i) const { return m_receiverAddresses[i]; }
+    ns3::Ptr<ns3::NetDevice> Bottleneck() const { return m_bottleneck; }
+    const std::vector<ns3::Ipv4Address> &SenderAddresses() const { return m_senderAddresses; }
+
+    // Whether this process simulates `node`: always, unless distributed.
+    static bool IsLocal(ns3::Ptr<ns3::Node> node)
+    {
+#ifdef NS3_MPI
+        return node->GetSystemId() == ns3::MpiInterface::GetSystemId();
+#else
+        return true;
+#endif
+    }
+
+  private:
+    ns3::NodeContainer m_routers, m_senders, m_receivers;
+    std::vector<ns3::Ipv4Address> m_senderAddresses, m_receiverAddresses;
+    ns3::Ptr<ns3::NetDevice> m_bottleneck;
+};
+
+#endif
@@ -0,0 +1,164 @@
+#! /usr/bin/env python3
+# Real server and client traffic across final_emu's simulated link. `setup`
+# creates two network namespaces, each with a tap, and `teardown` removes
+# them. `run` emulates every delay/rate point in turn: it starts ./server
+# in one namespace and final_emu, waits until the link is up, then runs
+# ./client from the other namespace. It prints what the client measured
+# next to how far the simulator fell behind real time. Needs root, ns-3
+# with the fd-net-device module and final_emu.cpp built in scratch/, and
+# the server and client built here (see README.md).
+import os
+import re
+import sys
+import time
+import signal
+import subprocess
+from optparse import OptionParser
+
+CLIENT_NETNS = "emu-client"
+SERVER_NETNS = "emu-server"
+TAP = "emu0"
+# (namespace, address of the real endpoint, address of its ns-3 router)
+SIDES = [(CLIENT_NETNS, "10.9.1.1", "10.9.1.2"), (SERVER_NETNS, "10.9.2.1", "10.9.2.2")]
+SERVER_ADDRESS = "10.9.2.1"
+
+
+def ip(*args):
+    subprocess.run(["ip"] + list(args), check=True)
+
+
+def setup(options):
+    """Namespaces and taps for final_emu, addressed as it expects."""
+    for netns, address, router in SIDES:
+        ip("netns", "add", netns)
+        ip("-n", netns, "link", "set", "lo", "up")
+        ip("-n", netns, "tuntap", "add", "dev", TAP, "mode", "tap")
+        ip("-n", netns, "addr", "add", address + "/24", "dev", TAP)
+        ip("-n", netns, "link", "set", TAP, "up")
+        ip("-n", netns, "route", "add", "10.9.0.0/16", "via", router, "onlink")
+
+
+def teardown(options):
+    for netns, _, _ in SIDES:
+        subprocess.run(["ip", "netns", "del", netns])
+
+
+def in_netns(netns, command):
+    return ["ip", "netns", "exec", netns] + command
+
+
+def rtt_ms(delay):
+    """Propagation RTT of an ns-3 delay such as "200ms"."""
+    match = re.match(r"^([0-9.]+)(ms|s|us)$", delay)
+    scale = {"s": 1e3, "ms": 1.0, "us": 1e-3}[match.group(2)]
+    return 2 * float(match.group(1)) * scale
+
+
+def mbps(rate):
+    """Mbit/s of an ns-3 data rate such as "5Mbps"."""
+    match = re.match(r"^([0-9.]+)([kMG]?)bps$", rate)
+    return float(match.group(1)) * {"": 1e-6, "k": 1e-3, "M": 1.0, "G": 1e3}[match.group(2)]
+
+
+def start_emulation(options, delay, rate):
+    """Start final_emu on one point and wait until it forwards packets."""
+    args = "--linkLatencies=%s --linkDataRate=%s --duration=%g --format=csv %s" % (
+        delay, rate, options.duration, options.extra)
+    emu = subprocess.Popen([os.path.join(".", "ns3"), "run", "--no-build",
+                            "scratch/final_emu " + args],
+                           cwd=options.ns3_dir, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    for line in emu.stderr:
+        if line.startswith(b"emu ready"):
+            return emu
+        sys.stderr.write(line.decode())
+    emu.wait()
+    raise RuntimeError("final_emu exited before the link came up")
+
+
+def run_client(options, buffers):
+    """Client output, or None if it did not finish within the emulation."""
+    command = ["./client", "-h", SERVER_ADDRESS, "-p", str(options.port), "-w", buffers]
+    if options.mode == "bulk":
+        command += ["-B", str(options.bulk_bytes)]
+    else:
+        command += ["-l", "-c", str(options.connections), "-d", str(options.duration - 2)]
+    try:
+        return subprocess.run(in_netns(CLIENT_NETNS, command), check=True, stdout=subprocess.PIPE,
+                              timeout=options.duration).stdout.decode()
+    except (subprocess.TimeoutExpired, subprocess.CalledProcessError):
+        return None
+
+
+def client_summary(options, out):
+    """Bulk: Mbit/s; load: requests/s and p99 latency in ms."""
+    if out is None:
+        return "did not finish"
+    if options.mode == "bulk":
+        match = re.search(r"received ([0-9]+) bytes in ([0-9.]+) s", out)
+        return "%.2f Mbit/s" % (int(match.group(1)) * 8 / float(match.group(2)) / 1e6)
+    rate = float(re.search(r"throughput ([0-9.]+)", out).group(1))
+    p99 = float(out.strip().splitlines()[-1].split()[2])
+    return "%.1f req/s, p99 %.1f ms" % (rate, p99 / 1e3)
+
+
+def run(options):
+    """Every delay/rate point: client result and real-time lag."""
+    print("%8s %8s %12s %12s %12s %9s  %s" % ("delay", "rate", "lag_mean_ms", "lag_p99_ms",
+                                             "lag_max_ms", "late(%)", "client"))
+    for delay in options.delays.split(","):
+        for rate in options.rates.split(","):
+            buffers = "%g:%g" % (mbps(rate), rtt_ms(delay))
+            server = subprocess.Popen(in_netns(SERVER_NETNS, ["./server", "-p", str(options.port),
+                                                              "-w", buffers]),
+                                      stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+            try:
+                emu = start_emulation(options, delay, rate)
+                out = run_client(options, buffers)
+                emu_out, emu_err = emu.communicate()
+            finally:
+                server.send_signal(signal.SIGTERM)
+                server.wait()
+            if emu.returncode != 0:
+                sys.stderr.write(emu_err.decode())
+                raise RuntimeError("final_emu failed at %s %s" % (delay, rate))
+            # delay,rate,sim_s,wall_s,up_mbps,down_mbps,lag_mean_ms,lag_p99_ms,lag_max_ms,late_pct
+            row = emu_out.decode().strip().splitlines()[-1].split(",")
+            print("%8s %8s %12s %12s %12s %9s  %s" % (delay, rate, row[6], row[7], row[8], row[9],
+                                                     client_summary(options, out)))
+            sys.stdout.flush()
+            time.sleep(1)
+
+
+def main(argv):
+    parser = OptionParser(usage="%prog [options] setup|run|teardown")
+    parser.add_option('--ns3-dir', default=".", dest='ns3_dir',
+                      help="ns-3 tree final_emu is built in")
+    parser.add_option('--delays', default="10ms,50ms,100ms,200ms,500ms", dest='delays',
+                      help="Comma-separated link delays")
+    parser.add_option('--rates', default="5Mbps", dest='rates',
+                      help="Comma-separated link rates")
+    parser.add_option('--duration', type="float", default=30.0, dest='duration',
+                      help="Seconds per point")
+    parser.add_option('--mode', default="bulk", dest='mode',
+                      help="Client traffic: bulk (one download) or load (request/reply)")
+    parser.add_option('--bulk-bytes', type="int", default=8 << 20, dest='bulk_bytes',
+                      help="Bytes per bulk download")
+    parser.add_option('--connections', type="int", default=16, dest='connections',
+                      help="Connections of the load generator")
+    parser.add_option('--port', type="int", default=12400, dest='port',
+                      help="Port the server listens on")
+    parser.add_option('--extra', default="", dest='extra',
+                      help="More final_emu options, e.g. \"--queueDisc=FqCoDel\"")
+    (options, args) = parser.parse_args(argv[1:])
+
+    commands = {"setup": setup, "run": run, "teardown": teardown}
+    if len(args) != 1 or args[0] not in commands:
+        parser.error("expected one of: " + ", ".join(sorted(commands)))
+    if options.mode not in ("bulk", "load"):
+        parser.error("--mode must be bulk or load")
+    commands[args[0]](options)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
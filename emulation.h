@@ -0,0 +1,179 @@
+// Emulation support for final_emu.cpp, which carries real traffic across a
+// simulated link. The real endpoints live in two network namespaces, each
+// holding a persistent tap device (emubench.py setup creates them). The
+// scenario attaches an FdNetDevice to each tap, so every Ethernet frame
+// the kernel sends on the tap enters the simulation and vice versa.
+//
+// Under RealtimeSimulatorImpl (best effort) events run at their wall-clock
+// time, or late when the simulator cannot keep up. RealtimeLag measures how
+// late: a probe event every interval records wall time elapsed since
+// Simulator::Run() minus simulated time. Once the lag grows, the emulated
+// link no longer has the delay and rate it was configured with, and the
+// numbers of that run describe the simulator rather than the path.
+#ifndef EMULATION_H
+#define EMULATION_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <linux/if_tun.h>
+#include <net/if.h>
+#include <numeric>
+#include <sched.h>
+#include <string>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <vector>
+
+#include "results.h"
+#include "sweep.h"
+
+struct EmuResult
+{
+    SweepPoint point;
+    double simSeconds, wallSeconds;
+    double upMbps, downMbps;    // bytes sent on the simulated link, client to server and back
+    double lagMeanMs, lagP99Ms, lagMaxMs;
+    double latePercent;         // probes later than the tolerance
+};
+
+// Attach to the tap `name` inside the network namespace `netns` (a name
+// under /var/run/netns, as `ip netns` creates them). The descriptor stays
+// bound to the tap after this thread returns to its own namespace. Needs
+// CAP_SYS_ADMIN for setns(). Returns -1 and reports why on failure.
+inline int
+OpenNetnsTap(const std::string &netns, const std::string &name)
+{
+    int self = open("/proc/self/ns/net", O_RDONLY);
+    int target = open(("/var/run/netns/" + netns).c_str(), O_RDONLY);
+    if (self < 0 || target < 0 || setns(target, CLONE_NEWNET) < 0)
+    {
+        std::cerr << "Cannot enter network namespace " << netns << ": " << strerror(errno) << std::endl;
+        if (self >= 0)
+        {
+            close(self);
+        }
+        if (target >= 0)
+        {
+            close(target);
+        }
+        return -1;
+    }
+    close(target);
+
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    ifr.ifr_flags = IFF_TAP | IFF_NO_PI;
+    strncpy(ifr.ifr_name, name.c_str(), IFNAMSIZ - 1);
+    int fd = open("/dev/net/tun", O_RDWR);
+    if (fd < 0 || ioctl(fd, TUNSETIFF, &ifr) < 0)
+    {
+        std::cerr << "Cannot attach to tap " << name << " in " << netns << ": " << strerror(errno)
+                  << std::endl;
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        fd = -1;
+    }
+
+    if (setns(self, CLONE_NEWNET) < 0)
+    {
+        std::cerr << "Cannot return to the original network namespace: " << strerror(errno) << std::endl;
+        std::exit(1);
+    }
+    close(self);
+    return fd;
+}
+
+// Add the size of every packet `device` transmits to *bytes.
+inline void
+CountTxBytes(uint64_t *bytes, ns3::Ptr<const ns3::Packet> packet)
+{
+    *bytes += packet->GetSize();
+}
+
+inline void
+CountDeviceTx(ns3::Ptr<ns3::NetDevice> device, uint64_t *bytes)
+{
+    device->TraceConnectWithoutContext("MacTx", ns3::MakeBoundCallback(&CountTxBytes, bytes));
+}
+
+class RealtimeLag
+{
+  public:
+    // Probe every `interval` of simulated time; probes more than
+    // `tolerance` late count as late.
+    void Start(ns3::Time interval, ns3::Time tolerance)
+    {
+        m_interval = interval;
+        m_tolerance = tolerance.GetSeconds();
+        ns3::Simulator::Schedule(interval, &RealtimeLag::Probe, this);
+    }
+
+    // Call right before Simulator::Run().
+    void RunStarting()
+    {
+        m_start = Clock::now();
+    }
+
+    // Fill in the timing fields of `r`; call after Simulator::Run().
+    void Summarize(EmuResult &r) const
+    {
+        r.simSeconds = ns3::Simulator::Now().GetSeconds();
+        r.wallSeconds = std::chrono::duration<double>(Clock::now() - m_start).count();
+        r.lagMeanMs = r.lagP99Ms = r.lagMaxMs = r.latePercent = 0;
+        if (m_lags.empty())
+        {
+            return;
+        }
+        std::vector<double> lags(m_lags);
+        std::sort(lags.begin(), lags.end());
+        size_t late = lags.end() - std::upper_bound(lags.begin(), lags.end(), m_tolerance);
+        r.lagMeanMs = std::accumulate(lags.begin(), lags.end(), 0.0) / lags.size() * 1e3;
+        r.lagP99Ms = lags[std::min(lags.size() - 1, (size_t)(lags.size() * 0.99))] * 1e3;
+        r.lagMaxMs = lags.back() * 1e3;
+        r.latePercent = 100.0 * late / lags.size();
+    }
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    void Probe()
+    {
+        double wall = std::chrono::duration<double>(Clock::now() - m_start).count();
+        m_lags.push_back(std::max(0.0, wall - ns3::Simulator::Now().GetSeconds()));
+        ns3::Simulator::Schedule(m_interval, &RealtimeLag::Probe, this);
+    }
+
+    ns3::Time m_interval;
+    double m_tolerance = 0;
+    Clock::time_point m_start;
+    std::vector<double> m_lags;  // seconds
+};
+
+// Emulation runs have no seeds or variants: real traffic is not seeded.
+inline ResultRow
+EmuColumns(const EmuResult &r = EmuResult())
+{
+    ResultRow row;
+    row.push_back(TextCell("delay", 8, r.point.delay));
+    row.push_back(TextCell("rate", 8, r.point.rate));
+    row.push_back(RealCell("sim_s", 13, r.simSeconds));
+    row.push_back(RealCell("wall_s", 13, r.wallSeconds));
+    row.push_back(RealCell("up_mbps", 13, r.upMbps));
+    row.push_back(RealCell("down_mbps", 13, r.downMbps));
+    row.push_back(RealCell("lag_mean_ms", 13, r.lagMeanMs));
+    row.push_back(RealCell("lag_p99_ms", 13, r.lagP99Ms));
+    row.push_back(RealCell("lag_max_ms", 13, r.lagMaxMs));
+    row.push_back(RealCell("late_pct", 13, r.latePercent));
+    return row;
+}
+
+#endif
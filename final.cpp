@@ -5,29 +5,39 @@
 #include "ns3/applications-module.h"
 #include "ns3/flow-monitor-module.h"
 
+#include "nstrace.h"
+#include "results.h"
+#include "simperf.h"
+
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE("TcpPerformanceTest");
 
-void PrintTcpThroughput(Ptr<FlowMonitor> flowMonitor, FlowMonitorHelper &monitorHelper) {
-    std::map<FlowId, FlowMonitor::FlowStats> flowStats = flowMonitor->GetFlowStats();
-    for (auto &flow : flowStats) {
-        double throughputKbps = (flow.second.rxBytes * 8.0 /
-                                 (flow.second.timeLastRxPacket.GetSeconds() -
-                                  flow.second.timeFirstTxPacket.GetSeconds())) /
-                                1024;
-        std::cout << "Flow ID " << flow.first << ": Throughput = " << throughputKbps << " Kbps" << std::endl;
-    }
-}
-
 int main(int argc, char *argv[]) {
     std::string linkDelay = "10ms";
+    std::string linkRate = "10Mbps";
+    std::string tracePath;
+    double traceInterval = 0.1;
+    std::string format = "table";
+    bool perf = false;
 
     CommandLine cmd;
     cmd.AddValue("linkDelay", "Point-to-Point link delay", linkDelay);
+    cmd.AddValue("trace", "Write a throughput/cwnd/RTT time series to this file", tracePath);
+    cmd.AddValue("traceInterval", "Throughput sampling period of the trace (seconds)", traceInterval);
+    cmd.AddValue("format", "Result format: table, csv or json (one object per line)", format);
+    cmd.AddValue("perf", "Report setup and run wall time, events/s and peak RSS on stderr", perf);
     cmd.Parse(argc, argv);
 
-    std::cout << "Starting TCP performance test with link delay = " << linkDelay << std::endl;
+    ResultFormat resultFormat;
+    if (!ParseResultFormat(format, resultFormat)) {
+        std::cerr << "Unknown format " << format << " (expected table, csv or json)" << std::endl;
+        return 1;
+    }
+
+    std::clog << "Starting TCP performance test with link delay = " << linkDelay << std::endl;
+    SimProfile profile;
+    profile.SetupStarting();
 
     // Create two nodes
     NodeContainer networkNodes;
@@ -35,7 +45,7 @@ int main(int argc, char *argv[]) {
 
     // Configure Point-to-Point link attributes
     PointToPointHelper p2pHelper;
-    p2pHelper.SetDeviceAttribute("DataRate", StringValue("10Mbps"));
+    p2pHelper.SetDeviceAttribute("DataRate", StringValue(linkRate));
     p2pHelper.SetChannelAttribute("Delay", StringValue(linkDelay));
 
     NetDeviceContainer p2pDevices = p2pHelper.Install(networkNodes);
@@ -49,7 +59,7 @@ int main(int argc, char *argv[]) {
     ipv4AddrHelper.SetBase("10.1.1.0", "255.255.255.0");
     Ipv4InterfaceContainer ipInterfaces = ipv4AddrHelper.Assign(p2pDevices);
 
-    std::cout << "Setting up TCP server and client applications..." << std::endl;
+    std::clog << "Setting up TCP server and client applications..." << std::endl;
 
     // Define TCP Server and Client
     uint16_t serverPort = 5000;
@@ -68,24 +78,42 @@ int main(int argc, char *argv[]) {
     clientApp.Start(Seconds(2.0));
     clientApp.Stop(Seconds(10.0));
 
-    std::cout << "Launching simulation..." << std::endl;
+    std::clog << "Launching simulation..." << std::endl;
 
     // Enable Flow Monitoring
     FlowMonitorHelper flowMonitorHelper;
+    ConfigureFlowMonitor(flowMonitorHelper);
     Ptr<FlowMonitor> monitorInstance = flowMonitorHelper.InstallAll();
 
+    // Optional time series of throughput, cwnd and RTT
+    ScenarioTracer tracer;
+    if (!tracePath.empty()) {
+        if (!tracer.Open(tracePath, Seconds(traceInterval))) {
+            std::cerr << "Cannot write " << tracePath << std::endl;
+            return 1;
+        }
+        tracer.SampleThroughput(monitorInstance);
+        tracer.TraceTcpSocketsAt(networkNodes.Get(0), Seconds(2.0));
+    }
+
     // Run the simulation
     Simulator::Stop(Seconds(12.0));
+    profile.RunStarting();
     Simulator::Run();
+    profile.RunFinished();
 
-    std::cout << "Simulation finished. Calculating TCP throughput..." << std::endl;
+    std::clog << "Simulation finished. Calculating flow statistics..." << std::endl;
 
-    // Print throughput statistics
-    PrintTcpThroughput(monitorInstance, flowMonitorHelper);
+    // Print throughput, loss, delay and jitter statistics
+    PrintResultHeader(resultFormat, FlowColumns());
+    SweepPoint point = {linkDelay, linkRate, 1};
+    ReportFlows(resultFormat, point, monitorInstance);
+    if (perf)
+        profile.Report(point);
 
     // Cleanup simulation
     Simulator::Destroy();
-    std::cout << "TCP performance test completed!" << std::endl;
+    std::clog << "TCP performance test completed!" << std::endl;
 
     return 0;
 }
@@ -0,0 +1,329 @@
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/applications-module.h"
+#include "ns3/flow-monitor-module.h"
+#ifdef NS3_MPI
+#include "ns3/mpi-interface.h"
+#include <mpi.h>
+#endif
+
+#include "dumbbell.h"
+#include "nstrace.h"
+#include "results.h"
+#include "simperf.h"
+#include "sweep.h"
+#include "tcpbdp.h"
+
+using namespace ns3;
+
+// Simulation parameters shared by every point of the sweep
+static DumbbellConfig topology;                    // Access links, receivers and queue disc
+static uint32_t flowsPerSender = 1;                // Bulk TCP flows each sender opens
+static uint32_t pktSizeBytes = 1448;               // Application write size (bytes)
+static double startWindow = 1.0;                   // Flows start at random in [1, 1 + startWindow] s
+static double simDuration = 20.0;                  // Total simulation time (seconds)
+static std::string tracePrefix;                    // Time-series trace files, off when empty
+static double traceInterval = 0.1;                 // Throughput sampling period (seconds)
+static ResultFormat resultFormat = RESULTS_TABLE;  // Set by --format
+static bool perfReport = false;                    // Set by --perf
+static bool reportFlows = false;                   // Per-flow rows instead of one aggregate row
+static double fairnessInterval = 0.5;              // Convergence sampling period (seconds)
+static double fairnessThreshold = 0.9;             // Jain's index counted as converged
+static bool distributed = false;                   // One point split over MPI ranks
+static uint32_t rank = 0;                          // This process's MPI rank
+
+static const uint16_t sinkPort = 9000;
+
+// Simulate one (bottleneck delay, bottleneck rate, sender count, seed)
+// point: every sender opens flowsPerSender bulk TCP flows, spread over the
+// receivers round-robin. Prints one aggregate row over all flows, or one
+// row per flow with --report=flows. The sender count is the point's
+// variant, "N=<senders>".
+//
+// A sweep runs every point in its own worker process (see sweep.h). A
+// distributed run simulates a single point with every MPI rank in this
+// function; only rank 0 prints. Throughput is counted as goodput at each
+// flow's own sink rather than by FlowMonitor, which cannot follow a flow
+// across ranks, so the serial and distributed rows are the same numbers.
+static void
+RunDumbbellPoint(const SweepPoint &point)
+{
+    RngSeedManager::SetSeed(point.seed);
+    SimProfile profile;
+    profile.SetupStarting();
+
+    DumbbellConfig config = topology;
+    config.senders = std::strtoul(point.variant.c_str() + 2, nullptr, 10);
+    config.bottleneckRate = point.rate;
+    config.bottleneckDelay = point.delay;
+    DumbbellTopology dumbbell(config);
+
+    // Every flow has a sink of its own, so its goodput is the sink's count
+    uint32_t flows = dumbbell.Senders() * flowsPerSender;
+    std::vector<Ptr<PacketSink>> sinks(flows);
+    for (uint32_t f = 0; f < flows; f++)
+    {
+        Ptr<Node> receiver = dumbbell.Receiver(f % dumbbell.Receivers());
+        if (!DumbbellTopology::IsLocal(receiver))
+        {
+            continue;
+        }
+        uint16_t port = sinkPort + f / dumbbell.Receivers();
+        PacketSinkHelper sinkHelper("ns3::TcpSocketFactory", InetSocketAddress(Ipv4Address::GetAny(), port));
+        ApplicationContainer sinkApp = sinkHelper.Install(receiver);
+        sinkApp.Start(Seconds(0.0));
+        sinkApp.Stop(Seconds(simDuration));
+        sinks[f] = DynamicCast<PacketSink>(sinkApp.Get(0));
+    }
+
+    // Staggered starts keep hundreds of flows from slow-starting in lockstep
+    Ptr<UniformRandomVariable> startTime = CreateObject<UniformRandomVariable>();
+    startTime->SetAttribute("Min", DoubleValue(1.0));
+    startTime->SetAttribute("Max", DoubleValue(1.0 + startWindow));
+    double firstStart = 1.0 + startWindow;
+    double lastStart = 1.0;
+
+    ScenarioTracer tracer;
+    bool tracing = !tracePrefix.empty();
+    if (tracing && !tracer.Open(TracePath(tracePrefix, point), Seconds(traceInterval)))
+    {
+        std::cerr << "Cannot write trace for " << point.delay << " " << point.rate << std::endl;
+        std::exit(1);
+    }
+
+    for (uint32_t f = 0; f < flows; f++)
+    {
+        // Every rank draws every start time, so they agree on all of them
+        double start = startTime->GetValue();
+        firstStart = std::min(firstStart, start);
+        lastStart = std::max(lastStart, start);
+
+        uint32_t sender = f % dumbbell.Senders();
+        uint32_t receiver = f % dumbbell.Receivers();
+        if (!DumbbellTopology::IsLocal(dumbbell.Sender(sender)))
+        {
+            continue;
+        }
+        uint16_t port = sinkPort + f / dumbbell.Receivers();
+        BulkSendHelper bulkHelper("ns3::TcpSocketFactory",
+                                  InetSocketAddress(dumbbell.ReceiverAddress(receiver), port));
+        bulkHelper.SetAttribute("MaxBytes", UintegerValue(0));  // Unlimited data
+        bulkHelper.SetAttribute("SendSize", UintegerValue(pktSizeBytes));
+        ApplicationContainer bulkApp = bulkHelper.Install(dumbbell.Sender(sender));
+        bulkApp.Start(Seconds(start));
+        bulkApp.Stop(Seconds(simDuration));
+        if (tracing)
+        {
+            tracer.TraceTcpSocketsAt(dumbbell.Sender(sender), Seconds(start));
+        }
+    }
+
+    // Flow Monitor for per-flow rows and traces; serial runs only
+    FlowMonitorHelper flowMonitorHelper;
+    Ptr<FlowMonitor> monitor;
+    if (!distributed)
+    {
+        ConfigureFlowMonitor(flowMonitorHelper);
+        monitor = flowMonitorHelper.InstallAll();
+    }
+    if (tracing)
+    {
+        tracer.SampleThroughput(monitor);
+    }
+
+    // Fairness over all flows once every one of them is running. A rank
+    // counts zero for the flows whose sinks another rank simulates.
+    FairnessSampler fairness;
+    fairness.Start(
+        [&sinks]() {
+            std::map<FlowId, uint64_t> bytes;
+            for (uint32_t f = 0; f < sinks.size(); f++)
+            {
+                bytes[f] = sinks[f] ? sinks[f]->GetTotalRx() : 0;
+            }
+            return bytes;
+        },
+        Seconds(lastStart),
+        Seconds(fairnessInterval));
+
+    // Start the simulation
+    Simulator::Stop(Seconds(simDuration));
+    profile.RunStarting();
+    Simulator::Run();
+    profile.RunFinished();
+
+#ifdef NS3_MPI
+    // Add up what every rank counted
+    if (distributed)
+    {
+        fairness.Reduce([](std::vector<uint64_t> &counts) {
+            MPI_Allreduce(MPI_IN_PLACE, counts.data(), counts.size(), MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+        });
+        uint64_t events = profile.Events();
+        long peakRssKb = profile.PeakRssKb();
+        MPI_Allreduce(MPI_IN_PLACE, &events, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+        MPI_Allreduce(MPI_IN_PLACE, &peakRssKb, 1, MPI_LONG, MPI_MAX, MPI_COMM_WORLD);
+        profile.SetTotals(events, peakRssKb);
+    }
+#endif
+
+    // Report the aggregate over all flows, or throughput, loss, delay and
+    // jitter per flow
+    FairnessResult result = fairness.Finish(point, Seconds(firstStart),
+                                            DataRate(point.rate).GetBitRate(), fairnessThreshold);
+    if (reportFlows)
+    {
+        ReportFlows(resultFormat, point, monitor);
+    }
+    else if (rank == 0)
+    {
+        PrintResultRow(resultFormat, FairnessColumns(result));
+    }
+
+    if (perfReport && rank == 0)
+    {
+        profile.Report(point);
+    }
+
+    // Clean up simulation state
+    Simulator::Destroy();
+}
+
+int main(int argc, char *argv[])
+{
+    // Sweep grid: every combination of these comma-separated lists is simulated
+    std::string senders = "10,50,100,200";      // Sender counts N
+    std::string bottleneckRate = "100Mbps";     // Bottleneck data rate(s)
+    std::string bottleneckDelay = "20ms";       // Bottleneck delay(s)
+    std::string seeds = "1";                    // RNG seeds
+    std::string tcp = "NewReno";                // Congestion control of every flow
+    std::string format = "table";               // Result format
+    std::string report = "fairness";            // fairness or flows
+    std::string simulator = "nullmsg";          // Distributed synchronization: nullmsg or barrier
+    int jobs = 0;                               // Parallel workers, 0 = one per CPU
+
+    CommandLine cmd;
+    cmd.AddValue("senders", "Comma-separated sender counts N to sweep", senders);
+    cmd.AddValue("receivers", "Receivers M; flows are spread over them round-robin", topology.receivers);
+    cmd.AddValue("flowsPerSender", "Bulk TCP flows opened by each sender", flowsPerSender);
+    cmd.AddValue("accessRate", "Data rate of every access link", topology.accessRate);
+    cmd.AddValue("accessDelay", "Delay of every access link", topology.accessDelay);
+    cmd.AddValue("bottleneckRate", "Comma-separated bottleneck data rates to sweep", bottleneckRate);
+    cmd.AddValue("bottleneckDelay", "Comma-separated bottleneck delays to sweep", bottleneckDelay);
+    cmd.AddValue("queueDisc", "Bottleneck queue disc (e.g. Fifo, FqCoDel, Red), default or none", topology.queueDisc);
+    cmd.AddValue("tcp", "TCP variant of every flow, e.g. NewReno, Cubic or Bbr", tcp);
+    cmd.AddValue("seeds", "Comma-separated RNG seeds to sweep", seeds);
+    cmd.AddValue("jobs", "Sweep points simulated in parallel (0 = one per CPU)", jobs);
+    cmd.AddValue("packetSize", "Application write size (bytes)", pktSizeBytes);
+    cmd.AddValue("startWindow", "Flows start at random within this many seconds after 1 s", startWindow);
+    cmd.AddValue("duration", "Total simulation time (seconds)", simDuration);
+    cmd.AddValue("trace", "Write a time-series trace per point to PREFIX-<delay>-<rate>-N_<senders>-s<seed>.trace", tracePrefix);
+    cmd.AddValue("traceInterval", "Throughput sampling period of the trace (seconds)", traceInterval);
+    cmd.AddValue("format", "Result format: table, csv or json (one object per line)", format);
+    cmd.AddValue("perf", "Report setup and run wall time, events/s and peak RSS per point on stderr", perfReport);
+    cmd.AddValue("report", "One aggregate row per run (fairness) or one row per flow (flows)", report);
+    cmd.AddValue("fairnessInterval", "Sampling period for convergence (seconds)", fairnessInterval);
+    cmd.AddValue("fairnessThreshold", "Jain's index from which the flows count as converged", fairnessThreshold);
+    cmd.AddValue("distributed", "Split one point over the MPI ranks this was started with (mpirun -np P)", distributed);
+    cmd.AddValue("simulator", "Distributed synchronization: nullmsg (null messages) or barrier (granted-time windows)", simulator);
+    cmd.Parse(argc, argv);
+    if (!ParseResultFormat(format, resultFormat))
+    {
+        std::cerr << "Unknown format " << format << " (expected table, csv or json)" << std::endl;
+        return 1;
+    }
+    if (report != "fairness" && report != "flows")
+    {
+        std::cerr << "Unknown report " << report << " (expected fairness or flows)" << std::endl;
+        return 1;
+    }
+    reportFlows = report == "flows";
+    if (!IsQueueDiscName(topology.queueDisc))
+    {
+        std::cerr << "Unknown queue disc " << topology.queueDisc << std::endl;
+        return 1;
+    }
+    TypeId tcpType;
+    if (!TypeId::LookupByNameFailSafe(TcpTypeName(tcp), &tcpType))
+    {
+        std::cerr << "Unknown TCP variant " << tcp << std::endl;
+        return 1;
+    }
+    Config::SetDefault("ns3::TcpL4Protocol::SocketType", TypeIdValue(tcpType));
+    if (topology.receivers < 1 || flowsPerSender < 1)
+    {
+        std::cerr << "Need at least one receiver and one flow per sender" << std::endl;
+        return 1;
+    }
+    if (topology.receivers > DUMBBELL_MAX_LEAVES)
+    {
+        std::cerr << "At most " << DUMBBELL_MAX_LEAVES << " receivers fit the address plan" << std::endl;
+        return 1;
+    }
+
+    std::vector<std::string> variants;
+    for (const std::string &n : SplitList(senders))
+    {
+        unsigned long count = std::strtoul(n.c_str(), nullptr, 10);
+        if (count < 1 || count > DUMBBELL_MAX_LEAVES)
+        {
+            std::cerr << "Bad sender count " << n << " (expected 1 to " << DUMBBELL_MAX_LEAVES << ")"
+                      << std::endl;
+            return 1;
+        }
+        // Flow f listens on sinkPort + f / receivers
+        uint64_t flows = (uint64_t)count * flowsPerSender;
+        if (sinkPort + (flows - 1) / topology.receivers > 65535)
+        {
+            std::cerr << "Too many flows per receiver for " << n << " senders: " << flows
+                      << " flows over " << topology.receivers << " receivers run out of ports"
+                      << std::endl;
+            return 1;
+        }
+        variants.push_back("N=" + n);
+    }
+
+    std::vector<SweepPoint> points = MakeSweepGrid(bottleneckDelay, bottleneckRate, seeds, variants);
+    if (distributed)
+    {
+        if (points.size() != 1 || reportFlows || !tracePrefix.empty())
+        {
+            std::cerr << "A distributed run simulates one point and reports only the aggregate row" << std::endl;
+            return 1;
+        }
+#ifdef NS3_MPI
+        if (simulator != "nullmsg" && simulator != "barrier")
+        {
+            std::cerr << "Unknown simulator " << simulator << " (expected nullmsg or barrier)" << std::endl;
+            return 1;
+        }
+        GlobalValue::Bind("SimulatorImplementationType",
+                          StringValue(simulator == "nullmsg" ? "ns3::NullMessageSimulatorImpl"
+                                                             : "ns3::DistributedSimulatorImpl"));
+        MpiInterface::Enable(&argc, &argv);
+        rank = MpiInterface::GetSystemId();
+        topology.partitions = MpiInterface::GetSize();
+        if (rank == 0)
+        {
+            PrintResultHeader(resultFormat, FairnessColumns());
+        }
+        RunDumbbellPoint(points[0]);
+        MpiInterface::Disable();
+        return 0;
+#else
+        std::cerr << "Distributed runs need ns-3 configured with --enable-mpi" << std::endl;
+        return 1;
+#endif
+    }
+
+    if (reportFlows)
+    {
+        PrintResultHeader(resultFormat, FlowColumns());
+    }
+    else
+    {
+        PrintResultHeader(resultFormat, FairnessColumns());
+    }
+    return RunSweep(points, jobs, RunDumbbellPoint) ? 1 : 0;
+}
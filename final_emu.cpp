@@ -0,0 +1,158 @@
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/fd-net-device-module.h"
+
+#include "bottleneck.h"
+#include "emulation.h"
+#include "results.h"
+#include "simperf.h"
+#include "sweep.h"
+
+using namespace ns3;
+
+// Real traffic over a simulated link: the client side's tap, one ns-3
+// router, the point-to-point link under test, a second router and the
+// server side's tap. `emubench.py setup` creates the namespaces and taps
+// with the addresses below.
+//
+//   emu-client ns          ns-3                               emu-server ns
+//   10.9.1.1 [tap] ---- 10.9.1.2 [L] ==link== [R] 10.9.2.2 ---- [tap] 10.9.2.1
+static std::string clientNetns = "emu-client";     // Namespace of the real client
+static std::string serverNetns = "emu-server";     // Namespace of the real server
+static std::string tapName = "emu0";               // Tap in each namespace
+static std::string queueDisc = "default";          // Queue disc on both link ends
+static double simDuration = 30.0;                  // Seconds per point, simulated and wall
+static double lagInterval = 0.01;                  // Real-time lag probe period (seconds)
+static double lagTolerance = 0.001;                // Lag counted as late (seconds)
+static ResultFormat resultFormat = RESULTS_TABLE;  // Set by --format
+static bool perfReport = false;                    // Set by --perf
+
+// One router with an FdNetDevice on the tap `tap` in `netns`, addressed
+// as `address`/24.
+static Ptr<FdNetDevice>
+AttachTap(Ptr<Node> router, const std::string &netns, const std::string &tap, const char *address)
+{
+    int fd = OpenNetnsTap(netns, tap);
+    if (fd < 0)
+    {
+        std::exit(1);
+    }
+    FdNetDeviceHelper fdHelper;
+    Ptr<FdNetDevice> device = DynamicCast<FdNetDevice>(fdHelper.Install(router).Get(0));
+    device->SetFileDescriptor(fd);
+    device->SetAddress(Mac48Address::Allocate());
+
+    Ipv4AddressHelper ipHelper;
+    ipHelper.SetBase(address, "255.255.255.0", "0.0.0.2");
+    ipHelper.Assign(NetDeviceContainer(device));
+    return device;
+}
+
+// Forward real traffic across one (delay, rate) link for simDuration
+// seconds of wall time and print how closely the simulator kept up. Runs
+// in its own worker process (see sweep.h); points run one at a time, since
+// they share the taps.
+static void
+RunEmuPoint(const SweepPoint &point)
+{
+    SimProfile profile;
+    profile.SetupStarting();
+
+    // Two routers joined by the link under test
+    NodeContainer routers;
+    routers.Create(2);
+    InternetStackHelper internet;
+    internet.Install(routers);
+
+    PointToPointHelper p2pHelper;
+    p2pHelper.SetDeviceAttribute("DataRate", StringValue(point.rate));
+    p2pHelper.SetChannelAttribute("Delay", StringValue(point.delay));
+    NetDeviceContainer link = p2pHelper.Install(routers);
+    InstallBottleneckQueue(link.Get(0), queueDisc);
+    InstallBottleneckQueue(link.Get(1), queueDisc);
+
+    Ipv4AddressHelper ipHelper;
+    ipHelper.SetBase("10.9.3.0", "255.255.255.252");
+    ipHelper.Assign(link);
+    FinishBottleneckQueue(link.Get(0), queueDisc);
+    FinishBottleneckQueue(link.Get(1), queueDisc);
+
+    // The real endpoints, one on each side
+    AttachTap(routers.Get(0), clientNetns, tapName, "10.9.1.0");
+    AttachTap(routers.Get(1), serverNetns, tapName, "10.9.2.0");
+    Ipv4GlobalRoutingHelper::PopulateRoutingTables();
+
+    // Bytes crossing the link in each direction
+    uint64_t upBytes = 0, downBytes = 0;
+    CountDeviceTx(link.Get(0), &upBytes);
+    CountDeviceTx(link.Get(1), &downBytes);
+
+    RealtimeLag lag;
+    lag.Start(Seconds(lagInterval), Seconds(lagTolerance));
+
+    // Drivers such as emubench.py start their traffic on this line
+    std::cerr << "emu ready delay=" << point.delay << " rate=" << point.rate << std::endl;
+
+    Simulator::Stop(Seconds(simDuration));
+    profile.RunStarting();
+    lag.RunStarting();
+    Simulator::Run();
+    profile.RunFinished();
+
+    EmuResult r;
+    r.point = point;
+    lag.Summarize(r);
+    r.upMbps = upBytes * 8 / r.simSeconds / 1e6;
+    r.downMbps = downBytes * 8 / r.simSeconds / 1e6;
+    PrintResultRow(resultFormat, EmuColumns(r));
+
+    if (perfReport)
+    {
+        profile.Report(point);
+    }
+
+    // Clean up simulation state
+    Simulator::Destroy();
+}
+
+int main(int argc, char *argv[])
+{
+    // Sweep grid, as in final_tcp1: every combination is emulated in turn
+    std::string linkDataRate = "5Mbps";                          // Link data rate(s)
+    std::string linkLatencies = "10ms,50ms,100ms,200ms,500ms";   // Link latencies
+    std::string format = "table";                                // Result format
+
+    CommandLine cmd;
+    cmd.AddValue("linkDataRate", "Comma-separated data rates of the link", linkDataRate);
+    cmd.AddValue("linkLatencies", "Comma-separated link latencies to sweep", linkLatencies);
+    cmd.AddValue("clientNetns", "Network namespace of the real client", clientNetns);
+    cmd.AddValue("serverNetns", "Network namespace of the real server", serverNetns);
+    cmd.AddValue("tap", "Name of the tap device in each namespace", tapName);
+    cmd.AddValue("queueDisc", "Queue disc at both ends of the link (e.g. Fifo, FqCoDel), default or none", queueDisc);
+    cmd.AddValue("duration", "Seconds each point runs, simulated and wall clock", simDuration);
+    cmd.AddValue("lagInterval", "Period of the real-time lag probe (seconds)", lagInterval);
+    cmd.AddValue("lagTolerance", "Lag from which a probe counts as late (seconds)", lagTolerance);
+    cmd.AddValue("format", "Result format: table, csv or json (one object per line)", format);
+    cmd.AddValue("perf", "Report setup and run wall time, events/s and peak RSS per point on stderr", perfReport);
+    cmd.Parse(argc, argv);
+    if (!ParseResultFormat(format, resultFormat))
+    {
+        std::cerr << "Unknown format " << format << " (expected table, csv or json)" << std::endl;
+        return 1;
+    }
+    if (!IsQueueDiscName(queueDisc))
+    {
+        std::cerr << "Unknown queue disc " << queueDisc << std::endl;
+        return 1;
+    }
+
+    // Events at wall-clock time, and real checksums for the kernel's packets
+    GlobalValue::Bind("SimulatorImplementationType", StringValue("ns3::RealtimeSimulatorImpl"));
+    GlobalValue::Bind("ChecksumEnabled", BooleanValue(true));
+
+    std::vector<SweepPoint> points = MakeSweepGrid(linkLatencies, linkDataRate, "1");
+    PrintResultHeader(resultFormat, EmuColumns());
+    return RunSweep(points, 1, RunEmuPoint) ? 1 : 0;
+}
@@ -6,88 +6,205 @@
 #include "ns3/ipv4-address-helper.h"
 #include "ns3/flow-monitor-module.h"
 
+#include "nstrace.h"
+#include "pcapture.h"
+#include "results.h"
+#include "simperf.h"
+#include "steady.h"
+#include "sweep.h"
+#include "tcpbdp.h"
+
 using namespace ns3;
 
-int main(int argc, char *argv[])
+// Simulation parameters shared by every point of the sweep
+static uint32_t packetSizeBytes = 1024;              // Packet size in bytes
+static double simDurationSeconds = 10.0;            // Total simulation duration
+static std::string tracePrefix;                     // Time-series trace files, off when empty
+static double traceInterval = 0.1;                 // Throughput sampling period (seconds)
+static ResultFormat resultFormat = RESULTS_TABLE;   // Set by --format
+static bool perfReport = false;                     // Set by --perf
+static bool autoBuffers = false;                    // Size TCP from the bandwidth-delay product
+static bool reportBdp = false;                      // Achieved vs theoretical instead of per-flow rows
+static SteadyStateOptions steadyState;              // --adaptive and its tuning
+static PcapOptions pcapOptions;                     // --pcap and its filters
+
+// Simulate one (latency, data rate, seed) point and print one table row
+// per flow, or one achieved-vs-theoretical row with --report=bdp. Runs in
+// its own worker process (see sweep.h).
+static void
+RunLatencyPoint(const SweepPoint &point)
 {
-    // Simulation parameters
-    uint32_t packetSizeBytes = 1024;              // Packet size in bytes
-    double simDurationSeconds = 10.0;            // Total simulation duration
-    std::string linkDataRate = "5Mbps";          // Link data rate
-    std::vector<std::string> linkLatencies = {   // Different latencies to simulate
-        "10ms", "50ms", "100ms", "200ms", "500ms"};
+    RngSeedManager::SetSeed(point.seed);
+    double stopSeconds = SteadyStateCap(steadyState, simDurationSeconds);
+    SimProfile profile;
+    profile.SetupStarting();
+
+    // TCP buffers and segment size: ns-3's defaults, or matched to the path
+    TcpPlan tcpPlan = autoBuffers ? BdpTcpPlan(point.rate, point.delay, 1500)
+                                  : DefaultTcpPlan(point.rate, point.delay);
+    if (autoBuffers)
+    {
+        ApplyTcpPlan(tcpPlan);
+    }
 
-    // Parse command-line arguments for customization
-    CommandLine cmd;
-    cmd.AddValue("linkDataRate", "Data rate of the link", linkDataRate);
-    cmd.Parse(argc, argv);
+    // Create two nodes for communication
+    NodeContainer nodes;
+    nodes.Create(2);
+
+    // Install the Internet stack on the nodes
+    InternetStackHelper internet;
+    internet.Install(nodes);
+
+    // Setup Point-to-Point channel with specified latency
+    PointToPointHelper p2pHelper;
+    p2pHelper.SetDeviceAttribute("DataRate", StringValue(point.rate));
+    p2pHelper.SetChannelAttribute("Delay", StringValue(point.delay));
+
+    // Install devices on the Point-to-Point channel
+    NetDeviceContainer devices = p2pHelper.Install(nodes);
+
+    // Assign IP addresses to the devices
+    Ipv4AddressHelper ipv4Helper;
+    ipv4Helper.SetBase("10.1.1.0", "255.255.255.0");
+    Ipv4InterfaceContainer ipInterfaces = ipv4Helper.Assign(devices);
+
+    // Setup a TCP server on the second node
+    uint16_t tcpPort = 8080;
+    Address serverAddress(InetSocketAddress(ipInterfaces.GetAddress(1), tcpPort));
+    PacketSinkHelper tcpServer("ns3::TcpSocketFactory", serverAddress);
+    ApplicationContainer serverApp = tcpServer.Install(nodes.Get(1));
+    serverApp.Start(Seconds(0.0));         // Start server immediately
+    serverApp.Stop(Seconds(stopSeconds));
+
+    // Setup a TCP client on the first node
+    BulkSendHelper tcpClient("ns3::TcpSocketFactory", serverAddress);
+    tcpClient.SetAttribute("MaxBytes", UintegerValue(0));        // Unlimited data
+    tcpClient.SetAttribute("SendSize", UintegerValue(packetSizeBytes));
+    ApplicationContainer clientApp = tcpClient.Install(nodes.Get(0));
+    clientApp.Start(Seconds(1.0));         // Start client after a short delay
+    clientApp.Stop(Seconds(stopSeconds));
+
+    // Enable Flow Monitor for tracking throughput
+    FlowMonitorHelper flowMonitorHelper;
+    ConfigureFlowMonitor(flowMonitorHelper);
+    Ptr<FlowMonitor> flowMonitor = flowMonitorHelper.InstallAll();
+    Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier>(flowMonitorHelper.GetClassifier());
+
+    // With --adaptive, stop as soon as the data flow's throughput is steady
+    SteadyStateStop steady;
+    if (steadyState.enabled)
+    {
+        steady.Start(steadyState, FlowMonitorCounter(flowMonitor, classifier, {ipInterfaces.GetAddress(0)}),
+                     Seconds(1.0), []() { Simulator::Stop(); });
+    }
 
-    // Base port number for TCP server
-    uint16_t baseTcpPort = 8080;
+    // Optional time series of per-flow throughput, cwnd and RTT
+    ScenarioTracer tracer;
+    if (!tracePrefix.empty())
+    {
+        if (!tracer.Open(TracePath(tracePrefix, point), Seconds(traceInterval)))
+        {
+            std::cerr << "Cannot write trace for " << point.delay << " " << point.rate << std::endl;
+            std::exit(1);
+        }
+        tracer.SampleThroughput(flowMonitor);
+        tracer.TraceTcpSocketsAt(nodes.Get(0), Seconds(1.0));
+    }
 
-    // Loop through each latency value for testing
-    for (const std::string &latency : linkLatencies)
+    // Optional packet capture at the sender's end of the link
+    PacketCapture capture;
+    if (!pcapOptions.prefix.empty())
     {
-        // Create two nodes for communication
-        NodeContainer nodes;
-        nodes.Create(2);
-
-        // Install the Internet stack on the nodes
-        InternetStackHelper internet;
-        internet.Install(nodes);
-
-        // Setup Point-to-Point channel with specified latency
-        PointToPointHelper p2pHelper;
-        p2pHelper.SetDeviceAttribute("DataRate", StringValue(linkDataRate));
-        p2pHelper.SetChannelAttribute("Delay", StringValue(latency));
-
-        // Install devices on the Point-to-Point channel
-        NetDeviceContainer devices = p2pHelper.Install(nodes);
-
-        // Assign IP addresses to the devices
-        Ipv4AddressHelper ipv4Helper;
-        ipv4Helper.SetBase("10.1.1.0", "255.255.255.0");
-        Ipv4InterfaceContainer ipInterfaces = ipv4Helper.Assign(devices);
-
-        // Setup a TCP server on the second node
-        uint16_t currentPort = baseTcpPort++; // Use a unique port for this iteration
-        Address serverAddress(InetSocketAddress(ipInterfaces.GetAddress(1), currentPort));
-        PacketSinkHelper tcpServer("ns3::TcpSocketFactory", serverAddress);
-        ApplicationContainer serverApp = tcpServer.Install(nodes.Get(1));
-        serverApp.Start(Seconds(0.0));         // Start server immediately
-        serverApp.Stop(Seconds(simDurationSeconds));
-
-        // Setup a TCP client on the first node
-        BulkSendHelper tcpClient("ns3::TcpSocketFactory", serverAddress);
-        tcpClient.SetAttribute("MaxBytes", UintegerValue(0));        // Unlimited data
-        tcpClient.SetAttribute("SendSize", UintegerValue(packetSizeBytes));
-        ApplicationContainer clientApp = tcpClient.Install(nodes.Get(0));
-        clientApp.Start(Seconds(1.0));         // Start client after a short delay
-        clientApp.Stop(Seconds(simDurationSeconds));
-
-        // Enable Flow Monitor for tracking throughput
-        FlowMonitorHelper flowMonitorHelper;
-        Ptr<FlowMonitor> flowMonitor = flowMonitorHelper.InstallAll();
-
-        // Run the simulation
-        Simulator::Stop(Seconds(simDurationSeconds));
-        Simulator::Run();
-
-        // Analyze throughput from flow statistics
-        flowMonitor->CheckForLostPackets();
-        std::map<FlowId, FlowMonitor::FlowStats> flowStats = flowMonitor->GetFlowStats();
-
-        for (auto const &flow : flowStats)
+        if (!capture.Open(TracePath(pcapOptions.prefix, point, ".pcap.gz"), pcapOptions))
         {
-            // Compute and display throughput for each flow
-            double throughputMbps = (flow.second.rxBytes * 8.0) / simDurationSeconds / 1e6; // in Mbps
-            std::cout << "Latency: " << latency << " - Flow ID: " << flow.first
-                      << " Throughput: " << throughputMbps << " Mbps" << std::endl;
+            std::cerr << "Cannot write capture for " << point.delay << " " << point.rate << std::endl;
+            std::exit(1);
         }
+        capture.Attach(devices.Get(0));
+    }
+
+    // Run the simulation
+    Simulator::Stop(Seconds(stopSeconds));
+    profile.RunStarting();
+    Simulator::Run();
+    profile.RunFinished();
+
+    // Report throughput, loss, delay and jitter per flow, or the data
+    // flow's throughput against what its window allows on this path
+    if (reportBdp)
+    {
+        ReportBdp(resultFormat, point, autoBuffers ? "bdp" : "default", tcpPlan, flowMonitor,
+                  classifier, ipInterfaces.GetAddress(0));
+    }
+    else
+    {
+        ReportFlows(resultFormat, point, flowMonitor);
+    }
+
+    if (steadyState.enabled)
+    {
+        steady.Report(point);
+    }
+    if (perfReport)
+    {
+        profile.Report(point);
+    }
+    if (!pcapOptions.prefix.empty())
+    {
+        capture.Finish(point);
+    }
+
+    // Clean up simulation state
+    Simulator::Destroy();
+}
+
+int main(int argc, char *argv[])
+{
+    // Sweep grid: every combination of these comma-separated lists is simulated
+    std::string linkDataRate = "5Mbps";                          // Link data rate(s)
+    std::string linkLatencies = "10ms,50ms,100ms,200ms,500ms";   // Different latencies to simulate
+    std::string seeds = "1";                                     // RNG seeds
+    std::string format = "table";                                // Result format
+    std::string report = "flows";                                // flows or bdp
+    int jobs = 0;                                                // Parallel workers, 0 = one per CPU
 
-        // Clean up simulation state
-        Simulator::Destroy();
+    // Parse command-line arguments for customization
+    CommandLine cmd;
+    cmd.AddValue("linkDataRate", "Comma-separated data rates of the link", linkDataRate);
+    cmd.AddValue("linkLatencies", "Comma-separated link latencies to sweep", linkLatencies);
+    cmd.AddValue("seeds", "Comma-separated RNG seeds to sweep", seeds);
+    cmd.AddValue("jobs", "Sweep points simulated in parallel (0 = one per CPU)", jobs);
+    cmd.AddValue("packetSize", "Packet size in bytes", packetSizeBytes);
+    cmd.AddValue("duration", "Simulation duration in seconds", simDurationSeconds);
+    cmd.AddValue("trace", "Write a time-series trace per point to PREFIX-<delay>-<rate>-s<seed>.trace", tracePrefix);
+    cmd.AddValue("traceInterval", "Throughput sampling period of the trace (seconds)", traceInterval);
+    cmd.AddValue("format", "Result format: table, csv or json (one object per line)", format);
+    cmd.AddValue("perf", "Report setup and run wall time, events/s and peak RSS per point on stderr", perfReport);
+    cmd.AddValue("autoBuffers", "Size socket buffers, segment size and window scaling from the bandwidth-delay product", autoBuffers);
+    cmd.AddValue("report", "One row per flow (flows) or achieved vs theoretical throughput per point (bdp)", report);
+    AddSteadyStateOptions(cmd, steadyState);
+    AddPcapOptions(cmd, pcapOptions);
+    cmd.Parse(argc, argv);
+    if (!ParseResultFormat(format, resultFormat))
+    {
+        std::cerr << "Unknown format " << format << " (expected table, csv or json)" << std::endl;
+        return 1;
+    }
+    if (report != "flows" && report != "bdp")
+    {
+        std::cerr << "Unknown report " << report << " (expected flows or bdp)" << std::endl;
+        return 1;
     }
+    reportBdp = report == "bdp";
 
-    return 0;
+    std::vector<SweepPoint> points = MakeSweepGrid(linkLatencies, linkDataRate, seeds);
+    if (reportBdp)
+    {
+        PrintResultHeader(resultFormat, BdpColumns());
+    }
+    else
+    {
+        PrintResultHeader(resultFormat, FlowColumns());
+    }
+    return RunSweep(points, jobs, RunLatencyPoint) ? 1 : 0;
 }
@@ -6,102 +6,296 @@
 #include "ns3/ipv4-address-helper.h"
 #include "ns3/flow-monitor-module.h"
 
+#include "bottleneck.h"
+#include "nstrace.h"
+#include "pcapture.h"
+#include "results.h"
+#include "simperf.h"
+#include "steady.h"
+#include "sweep.h"
+#include "tcpbdp.h"
+
 using namespace ns3;
 
-int main(int argc, char *argv[])
+// Simulation parameters shared by every point of the sweep
+static uint32_t pktSizeBytes = 1024;               // Packet size (bytes)
+static double simDuration = 10.0;                  // Total simulation time (seconds)
+static std::string tracePrefix;                    // Time-series trace files, off when empty
+static double traceInterval = 0.1;                 // Throughput sampling period (seconds)
+static ResultFormat resultFormat = RESULTS_TABLE;  // Set by --format
+static bool perfReport = false;                    // Set by --perf
+static bool reportFlows = false;                   // Per-flow rows instead of one fairness row
+static double fairnessInterval = 0.5;              // Convergence sampling period (seconds)
+static double fairnessThreshold = 0.9;             // Jain's index counted as converged
+static SteadyStateOptions steadyState;             // --adaptive and its tuning
+static PcapOptions pcapOptions;                    // --pcap and its filters
+
+// Start times of the two flows
+static const double flowStart1 = 1.0;
+static const double flowStart2 = 1.5;
+
+// A sweep variant is "<flow 1 TCP>+<flow 2 TCP>/<bottleneck queue disc>",
+// e.g. "Cubic+Bbr/FqCoDel". Returns false if any part is malformed or
+// names no registered TypeId.
+static bool
+ParseVariant(const std::string &variant, TypeId &tcp1, TypeId &tcp2, std::string &queueDisc)
 {
-    // Define default simulation parameters
-    uint32_t pktSizeBytes = 1024;               // Packet size (bytes)
-    double simDuration = 10.0;                  // Total simulation time (seconds)
-    std::string linkRate = "5Mbps";             // Data rate of the Point-to-Point link
-    std::vector<std::string> delayOptions = {   // Different latencies to experiment with
-        "10ms", "50ms", "100ms", "200ms", "500ms"};
+    size_t plus = variant.find('+');
+    size_t slash = variant.find('/');
+    if (plus == std::string::npos || slash == std::string::npos || plus > slash)
+    {
+        return false;
+    }
+    queueDisc = variant.substr(slash + 1);
+    if (!IsQueueDiscName(queueDisc))
+    {
+        return false;
+    }
+    return TypeId::LookupByNameFailSafe(TcpTypeName(variant.substr(0, plus)), &tcp1) &&
+           TypeId::LookupByNameFailSafe(TcpTypeName(variant.substr(plus + 1, slash - plus - 1)), &tcp2);
+}
 
-    // Allow command-line customization
-    CommandLine cmd;
-    cmd.AddValue("linkRate", "Data rate for the Point-to-Point link", linkRate);
-    cmd.Parse(argc, argv);
+// Sockets a node creates from now on use this congestion control.
+static void
+SetSocketType(Ptr<Node> node, TypeId tcp)
+{
+    node->GetObject<TcpL4Protocol>()->SetAttribute("SocketType", TypeIdValue(tcp));
+}
+
+// Simulate two competing TCP flows at one (delay, rate, variant, seed)
+// point and print one fairness row, or one row per flow with --report=flows.
+// Runs in its own worker process (see sweep.h).
+static void
+RunDelayPoint(const SweepPoint &point)
+{
+    RngSeedManager::SetSeed(point.seed);
+    double stopSeconds = SteadyStateCap(steadyState, simDuration);
+    SimProfile profile;
+    profile.SetupStarting();
+
+    TypeId tcp1, tcp2;
+    std::string queueDisc;
+    if (!ParseVariant(point.variant, tcp1, tcp2, queueDisc))
+    {
+        std::cerr << "Bad variant " << point.variant << std::endl;
+        std::exit(1);
+    }
+
+    // TCP sized to the bandwidth-delay product, so that on long, fast paths
+    // the window is limited by congestion control and not by ns-3's defaults
+    ApplyTcpPlan(BdpTcpPlan(point.rate, point.delay, 1500));
 
     // Base TCP port for applications
     uint16_t startingPort = 9000;
 
-    // Iterate over the specified latencies to conduct multiple simulations
-    for (const std::string &delay : delayOptions)
-    {
-        // Create a pair of nodes
-        NodeContainer networkNodes;
-        networkNodes.Create(2);
-
-        // Install the Internet protocol stack on both nodes
-        InternetStackHelper internetHelper;
-        internetHelper.Install(networkNodes);
-
-        // Configure Point-to-Point channel parameters
-        PointToPointHelper p2pHelper;
-        p2pHelper.SetDeviceAttribute("DataRate", StringValue(linkRate));
-        p2pHelper.SetChannelAttribute("Delay", StringValue(delay));
-
-        // Establish the Point-to-Point link
-        NetDeviceContainer p2pDevices = p2pHelper.Install(networkNodes);
-
-        // Assign IP addresses to the nodes
-        Ipv4AddressHelper ipHelper;
-        ipHelper.SetBase("10.1.1.0", "255.255.255.0");
-        Ipv4InterfaceContainer ipInterfaces = ipHelper.Assign(p2pDevices);
-
-        // Configure the first TCP server application
-        uint16_t tcpPort1 = startingPort++;
-        Address serverAddr1(InetSocketAddress(ipInterfaces.GetAddress(1), tcpPort1));
-        PacketSinkHelper tcpServerHelper1("ns3::TcpSocketFactory", serverAddr1);
-        ApplicationContainer serverApp1 = tcpServerHelper1.Install(networkNodes.Get(1));
-        serverApp1.Start(Seconds(0.0));  // Start server immediately
-        serverApp1.Stop(Seconds(simDuration));
-
-        // Configure the first TCP client application
-        BulkSendHelper tcpClientHelper1("ns3::TcpSocketFactory", serverAddr1);
-        tcpClientHelper1.SetAttribute("MaxBytes", UintegerValue(0));  // Unlimited data
-        tcpClientHelper1.SetAttribute("SendSize", UintegerValue(pktSizeBytes));
-        ApplicationContainer clientApp1 = tcpClientHelper1.Install(networkNodes.Get(0));
-        clientApp1.Start(Seconds(1.0));  // Slight delay before starting the client
-        clientApp1.Stop(Seconds(simDuration));
-
-        // Configure the second TCP server application
-        uint16_t tcpPort2 = startingPort++;
-        Address serverAddr2(InetSocketAddress(ipInterfaces.GetAddress(1), tcpPort2));
-        PacketSinkHelper tcpServerHelper2("ns3::TcpSocketFactory", serverAddr2);
-        ApplicationContainer serverApp2 = tcpServerHelper2.Install(networkNodes.Get(1));
-        serverApp2.Start(Seconds(0.0));  // Start server immediately
-        serverApp2.Stop(Seconds(simDuration));
-
-        // Configure the second TCP client application
-        BulkSendHelper tcpClientHelper2("ns3::TcpSocketFactory", serverAddr2);
-        tcpClientHelper2.SetAttribute("MaxBytes", UintegerValue(0));  // Unlimited data
-        tcpClientHelper2.SetAttribute("SendSize", UintegerValue(pktSizeBytes));
-        ApplicationContainer clientApp2 = tcpClientHelper2.Install(networkNodes.Get(0));
-        clientApp2.Start(Seconds(1.5));  // Slightly later start for the second client
-        clientApp2.Stop(Seconds(simDuration));
-
-        // Install the Flow Monitor to gather statistics
-        FlowMonitorHelper flowMonitorHelper;
-        Ptr<FlowMonitor> monitor = flowMonitorHelper.InstallAll();
-
-        // Start the simulation
-        Simulator::Stop(Seconds(simDuration));
-        Simulator::Run();
-
-        // Analyze and print throughput data for each flow
-        monitor->CheckForLostPackets();
-        std::map<FlowId, FlowMonitor::FlowStats> flowStatistics = monitor->GetFlowStats();
-        for (const auto &flow : flowStatistics)
+    // Create a pair of nodes
+    NodeContainer networkNodes;
+    networkNodes.Create(2);
+
+    // Install the Internet protocol stack on both nodes
+    InternetStackHelper internetHelper;
+    internetHelper.Install(networkNodes);
+
+    // Configure Point-to-Point channel parameters
+    PointToPointHelper p2pHelper;
+    p2pHelper.SetDeviceAttribute("DataRate", StringValue(point.rate));
+    p2pHelper.SetChannelAttribute("Delay", StringValue(point.delay));
+
+    // Establish the Point-to-Point link
+    NetDeviceContainer p2pDevices = p2pHelper.Install(networkNodes);
+
+    // Queue discipline at the bottleneck, the sender's egress
+    InstallBottleneckQueue(p2pDevices.Get(0), queueDisc);
+
+    // Assign IP addresses to the nodes
+    Ipv4AddressHelper ipHelper;
+    ipHelper.SetBase("10.1.1.0", "255.255.255.0");
+    Ipv4InterfaceContainer ipInterfaces = ipHelper.Assign(p2pDevices);
+    FinishBottleneckQueue(p2pDevices.Get(0), queueDisc);
+
+    // Configure the first TCP server application
+    uint16_t tcpPort1 = startingPort;
+    Address serverAddr1(InetSocketAddress(ipInterfaces.GetAddress(1), tcpPort1));
+    PacketSinkHelper tcpServerHelper1("ns3::TcpSocketFactory", serverAddr1);
+    ApplicationContainer serverApp1 = tcpServerHelper1.Install(networkNodes.Get(1));
+    serverApp1.Start(Seconds(0.0));  // Start server immediately
+    serverApp1.Stop(Seconds(stopSeconds));
+
+    // Configure the first TCP client application
+    BulkSendHelper tcpClientHelper1("ns3::TcpSocketFactory", serverAddr1);
+    tcpClientHelper1.SetAttribute("MaxBytes", UintegerValue(0));  // Unlimited data
+    tcpClientHelper1.SetAttribute("SendSize", UintegerValue(pktSizeBytes));
+    ApplicationContainer clientApp1 = tcpClientHelper1.Install(networkNodes.Get(0));
+    clientApp1.Start(Seconds(flowStart1));  // Slight delay before starting the client
+    clientApp1.Stop(Seconds(stopSeconds));
+    Simulator::Schedule(Seconds(flowStart1) - NanoSeconds(1), &SetSocketType, networkNodes.Get(0), tcp1);
+
+    // Configure the second TCP server application
+    uint16_t tcpPort2 = startingPort + 1;
+    Address serverAddr2(InetSocketAddress(ipInterfaces.GetAddress(1), tcpPort2));
+    PacketSinkHelper tcpServerHelper2("ns3::TcpSocketFactory", serverAddr2);
+    ApplicationContainer serverApp2 = tcpServerHelper2.Install(networkNodes.Get(1));
+    serverApp2.Start(Seconds(0.0));  // Start server immediately
+    serverApp2.Stop(Seconds(stopSeconds));
+
+    // Configure the second TCP client application
+    BulkSendHelper tcpClientHelper2("ns3::TcpSocketFactory", serverAddr2);
+    tcpClientHelper2.SetAttribute("MaxBytes", UintegerValue(0));  // Unlimited data
+    tcpClientHelper2.SetAttribute("SendSize", UintegerValue(pktSizeBytes));
+    ApplicationContainer clientApp2 = tcpClientHelper2.Install(networkNodes.Get(0));
+    clientApp2.Start(Seconds(flowStart2));  // Slightly later start for the second client
+    clientApp2.Stop(Seconds(stopSeconds));
+    Simulator::Schedule(Seconds(flowStart2) - NanoSeconds(1), &SetSocketType, networkNodes.Get(0), tcp2);
+
+    // Install the Flow Monitor to gather statistics
+    FlowMonitorHelper flowMonitorHelper;
+    ConfigureFlowMonitor(flowMonitorHelper);
+    Ptr<FlowMonitor> monitor = flowMonitorHelper.InstallAll();
+    Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier>(flowMonitorHelper.GetClassifier());
+
+    // Fairness between the two data flows once both are running
+    FairnessSampler fairness;
+    fairness.Start(monitor, classifier, {ipInterfaces.GetAddress(0)}, Seconds(flowStart2),
+                   Seconds(fairnessInterval));
+
+    // With --adaptive, stop as soon as both data flows are steady
+    SteadyStateStop steady;
+    if (steadyState.enabled)
+    {
+        steady.Start(steadyState, FlowMonitorCounter(monitor, classifier, {ipInterfaces.GetAddress(0)}),
+                     Seconds(flowStart2), []() { Simulator::Stop(); });
+    }
+
+    // Optional time series of per-flow throughput, cwnd and RTT
+    ScenarioTracer tracer;
+    if (!tracePrefix.empty())
+    {
+        if (!tracer.Open(TracePath(tracePrefix, point), Seconds(traceInterval)))
         {
-            double throughputMbps = (flow.second.rxBytes * 8.0) / simDuration / 1e6;  // Convert to Mbps
-            std::cout << "Latency: " << delay << " - Flow ID: " << flow.first
-                      << " Throughput: " << throughputMbps << " Mbps" << std::endl;
+            std::cerr << "Cannot write trace for " << point.delay << " " << point.rate << std::endl;
+            std::exit(1);
         }
+        tracer.SampleThroughput(monitor);
+        tracer.TraceTcpSocketsAt(networkNodes.Get(0), Seconds(flowStart1));
+        tracer.TraceTcpSocketsAt(networkNodes.Get(0), Seconds(flowStart2));
+    }
 
-        // Clean up simulation state
-        Simulator::Destroy();
+    // Optional packet capture at the sender's end of the link
+    PacketCapture capture;
+    if (!pcapOptions.prefix.empty())
+    {
+        if (!capture.Open(TracePath(pcapOptions.prefix, point, ".pcap.gz"), pcapOptions))
+        {
+            std::cerr << "Cannot write capture for " << point.delay << " " << point.rate << std::endl;
+            std::exit(1);
+        }
+        capture.Attach(p2pDevices.Get(0));
+    }
+
+    // Start the simulation
+    Simulator::Stop(Seconds(stopSeconds));
+    profile.RunStarting();
+    Simulator::Run();
+    profile.RunFinished();
+
+    // Report fairness of the run, or throughput, loss, delay and jitter per flow
+    if (reportFlows)
+    {
+        ReportFlows(resultFormat, point, monitor);
+    }
+    else
+    {
+        FairnessResult result =
+            fairness.Finish(point, Seconds(flowStart1), DataRate(point.rate).GetBitRate(), fairnessThreshold);
+        PrintResultRow(resultFormat, FairnessColumns(result));
     }
 
-    return 0;
+    if (steadyState.enabled)
+    {
+        steady.Report(point);
+    }
+    if (perfReport)
+    {
+        profile.Report(point);
+    }
+    if (!pcapOptions.prefix.empty())
+    {
+        capture.Finish(point);
+    }
+
+    // Clean up simulation state
+    Simulator::Destroy();
+}
+
+int main(int argc, char *argv[])
+{
+    // Sweep grid: every combination of these comma-separated lists is simulated
+    std::string linkRate = "5Mbps";                             // Data rate(s) of the Point-to-Point link
+    std::string delayOptions = "10ms,50ms,100ms,200ms,500ms";   // Different latencies to experiment with
+    std::string seeds = "1";                                    // RNG seeds
+    std::string tcpVariants = "NewReno+NewReno";                // TCP of flow 1 + flow 2, per run
+    std::string queueDiscs = "default";                         // Bottleneck queue disciplines
+    std::string format = "table";                               // Result format
+    std::string report = "fairness";                            // fairness or flows
+    int jobs = 0;                                               // Parallel workers, 0 = one per CPU
+
+    // Allow command-line customization
+    CommandLine cmd;
+    cmd.AddValue("linkRate", "Comma-separated data rates for the Point-to-Point link", linkRate);
+    cmd.AddValue("delayOptions", "Comma-separated link delays to sweep", delayOptions);
+    cmd.AddValue("seeds", "Comma-separated RNG seeds to sweep", seeds);
+    cmd.AddValue("tcpVariants", "Comma-separated TCP pairs FLOW1+FLOW2 to sweep, e.g. NewReno+Cubic,Cubic+Bbr", tcpVariants);
+    cmd.AddValue("queueDiscs", "Comma-separated bottleneck queue discs to sweep (e.g. Fifo, FqCoDel, Red), default or none", queueDiscs);
+    cmd.AddValue("jobs", "Sweep points simulated in parallel (0 = one per CPU)", jobs);
+    cmd.AddValue("packetSize", "Packet size (bytes)", pktSizeBytes);
+    cmd.AddValue("duration", "Total simulation time (seconds)", simDuration);
+    cmd.AddValue("trace", "Write a time-series trace per point to PREFIX-<delay>-<rate>-<variant>-s<seed>.trace", tracePrefix);
+    cmd.AddValue("traceInterval", "Throughput sampling period of the trace (seconds)", traceInterval);
+    cmd.AddValue("format", "Result format: table, csv or json (one object per line)", format);
+    cmd.AddValue("perf", "Report setup and run wall time, events/s and peak RSS per point on stderr", perfReport);
+    cmd.AddValue("report", "One fairness row per run (fairness) or one row per flow (flows)", report);
+    cmd.AddValue("fairnessInterval", "Sampling period for convergence (seconds)", fairnessInterval);
+    cmd.AddValue("fairnessThreshold", "Jain's index from which the flows count as converged", fairnessThreshold);
+    AddSteadyStateOptions(cmd, steadyState);
+    AddPcapOptions(cmd, pcapOptions);
+    cmd.Parse(argc, argv);
+    if (!ParseResultFormat(format, resultFormat))
+    {
+        std::cerr << "Unknown format " << format << " (expected table, csv or json)" << std::endl;
+        return 1;
+    }
+    if (report != "fairness" && report != "flows")
+    {
+        std::cerr << "Unknown report " << report << " (expected fairness or flows)" << std::endl;
+        return 1;
+    }
+    reportFlows = report == "flows";
+
+    // Every TCP pair runs against every queue disc
+    std::vector<std::string> variants;
+    for (const std::string &tcp : SplitList(tcpVariants))
+    {
+        for (const std::string &queue : SplitList(queueDiscs))
+        {
+            TypeId tcp1, tcp2;
+            std::string queueDisc;
+            variants.push_back(tcp + "/" + queue);
+            if (!ParseVariant(variants.back(), tcp1, tcp2, queueDisc))
+            {
+                std::cerr << "Unknown TCP pair or queue disc " << variants.back() << std::endl;
+                return 1;
+            }
+        }
+    }
+
+    std::vector<SweepPoint> points = MakeSweepGrid(delayOptions, linkRate, seeds, variants);
+    if (reportFlows)
+    {
+        PrintResultHeader(resultFormat, FlowColumns());
+    }
+    else
+    {
+        PrintResultHeader(resultFormat, FairnessColumns());
+    }
+    return RunSweep(points, jobs, RunDelayPoint) ? 1 : 0;
 }
@@ -6,105 +6,191 @@
 #include "ns3/ipv4-address-helper.h"
 #include "ns3/flow-monitor-module.h"
 
+#include "nstrace.h"
+#include "pcapture.h"
+#include "results.h"
+#include "simperf.h"
+#include "steady.h"
+#include "sweep.h"
+
 using namespace ns3;
 
-int main(int argc, char *argv[])
+// Simulation parameters: can be adjusted for testing different scenarios.
+static uint32_t pktSizeBytes = 1024;               // Size of packets sent (in bytes).
+static double simDuration = 10.0;                  // Duration of each simulation (seconds).
+static std::string offeredLoad = "4Mbps";           // Rate the UDP sender offers.
+static double drainTime = 1.0;                     // Senders stop this early so queues drain.
+static std::string tracePrefix;                    // Time-series trace files, off when empty
+static double traceInterval = 0.1;                 // Throughput sampling period (seconds)
+static ResultFormat resultFormat = RESULTS_TABLE;  // Set by --format.
+static bool perfReport = false;                    // Set by --perf.
+static SteadyStateOptions steadyState;             // --adaptive and its tuning.
+static PcapOptions pcapOptions;                    // --pcap and its filters.
+
+// OnOffApplication stops for good once it has sent MaxBytes, so any limit
+// below what the senders already sent ends them now. The simulation ends
+// drainTime later, after the packets in flight have arrived.
+static void
+StopSenders(ApplicationContainer senders)
 {
-    // Simulation parameters: can be adjusted for testing different scenarios.
-    uint32_t pktSizeBytes = 1024;               // Size of packets sent (in bytes).
-    double simDuration = 10.0;                  // Duration of each simulation (seconds).
-    std::string linkRate = "5Mbps";             // Bandwidth for the Point-to-Point link.
-    std::vector<std::string> delayOptions = {   // Latency options to test (milliseconds).
-        "10ms", "50ms", "100ms", "200ms", "500ms"};
-
-    // Allow customization of linkRate from the command line.
-    CommandLine cmd;
-    cmd.AddValue("linkRate", "Data rate for the Point-to-Point link", linkRate);
-    cmd.Parse(argc, argv);
+    for (uint32_t i = 0; i < senders.GetN(); i++)
+    {
+        senders.Get(i)->SetAttribute("MaxBytes", UintegerValue(1));
+    }
+    Simulator::Stop(Seconds(drainTime));
+}
 
-    // Start TCP servers with incremented base port values.
+// Simulate one UDP flow at one (delay, rate, seed) point and print its
+// row. Runs in its own worker process (see sweep.h).
+static void
+RunUdpPoint(const SweepPoint &point)
+{
+    RngSeedManager::SetSeed(point.seed);
+    double stopSeconds = SteadyStateCap(steadyState, simDuration);
+    SimProfile profile;
+    profile.SetupStarting();
+
+    // 1. **Node Setup**: Create two nodes (source and destination).
+    NodeContainer networkNodes;
+    networkNodes.Create(2);
+
+    // Install the internet stack (TCP/IP protocol stack) on both nodes.
+    InternetStackHelper internetHelper;
+    internetHelper.Install(networkNodes);
+
+    // 2. **Point-to-Point Link Configuration**:
+    // Set the data rate and latency for the connection.
+    PointToPointHelper p2pHelper;
+    p2pHelper.SetDeviceAttribute("DataRate", StringValue(point.rate));
+    p2pHelper.SetChannelAttribute("Delay", StringValue(point.delay));
+
+    // Establish the Point-to-Point link between the nodes.
+    NetDeviceContainer p2pDevices = p2pHelper.Install(networkNodes);
+
+    // Assign IP addresses to the interfaces of the nodes.
+    Ipv4AddressHelper ipHelper;
+    ipHelper.SetBase("10.1.1.0", "255.255.255.0");
+    Ipv4InterfaceContainer ipInterfaces = ipHelper.Assign(p2pDevices);
+
+    // 3. **Application Setup**: Configure a UDP sink and a constant-rate sender.
     uint16_t startingPort = 9000;
 
-    // Iterate over different latencies to evaluate network performance.
-    for (const std::string &delay : delayOptions)
+    // Configure the UDP sink on Node 2.
+    uint16_t udpPort = startingPort;
+    PacketSinkHelper udpServerHelper("ns3::UdpSocketFactory",
+                                     InetSocketAddress(Ipv4Address::GetAny(), udpPort));
+    ApplicationContainer serverApp = udpServerHelper.Install(networkNodes.Get(1));
+    serverApp.Start(Seconds(0.0));
+    serverApp.Stop(Seconds(stopSeconds));
+
+    // Configure the UDP sender on Node 1: always on, at the offered load.
+    OnOffHelper udpClientHelper("ns3::UdpSocketFactory",
+                                InetSocketAddress(ipInterfaces.GetAddress(1), udpPort));
+    udpClientHelper.SetConstantRate(DataRate(offeredLoad), pktSizeBytes);
+    ApplicationContainer clientApp = udpClientHelper.Install(networkNodes.Get(0));
+    clientApp.Start(Seconds(1.0));
+    clientApp.Stop(Seconds(stopSeconds - drainTime));
+
+    // 4. **Flow Monitoring**: Install the Flow Monitor to track statistics.
+    FlowMonitorHelper flowMonitorHelper;
+    ConfigureFlowMonitor(flowMonitorHelper);
+    Ptr<FlowMonitor> monitor = flowMonitorHelper.InstallAll();
+
+    // With --adaptive, stop the sender once the flow is steady and let the
+    // queue drain before the simulation ends.
+    SteadyStateStop steady;
+    if (steadyState.enabled)
     {
-        // 1. **Node Setup**: Create two nodes (source and destination).
-        NodeContainer networkNodes;
-        networkNodes.Create(2);
-
-        // Install the internet stack (TCP/IP protocol stack) on both nodes.
-        InternetStackHelper internetHelper;
-        internetHelper.Install(networkNodes);
-
-        // 2. **Point-to-Point Link Configuration**: 
-        // Set the data rate and latency for the connection.
-        PointToPointHelper p2pHelper;
-        p2pHelper.SetDeviceAttribute("DataRate", StringValue(linkRate));
-        p2pHelper.SetChannelAttribute("Delay", StringValue(delay));
-
-        // Establish the Point-to-Point link between the nodes.
-        NetDeviceContainer p2pDevices = p2pHelper.Install(networkNodes);
-
-        // Assign IP addresses to the interfaces of the nodes.
-        Ipv4AddressHelper ipHelper;
-        ipHelper.SetBase("10.1.1.0", "255.255.255.0");
-        Ipv4InterfaceContainer ipInterfaces = ipHelper.Assign(p2pDevices);
-
-        // 3. **Application Setup**: Configure servers and clients.
-
-        // Configure the first TCP server on Node 2.
-        uint16_t tcpPort1 = startingPort++;
-        Address serverAddr1(InetSocketAddress(ipInterfaces.GetAddress(1), tcpPort1));
-        PacketSinkHelper tcpServerHelper1("ns3::TcpSocketFactory", serverAddr1);
-        ApplicationContainer serverApp1 = tcpServerHelper1.Install(networkNodes.Get(1));
-        serverApp1.Start(Seconds(0.0));
-        serverApp1.Stop(Seconds(simDuration));
-
-        // Configure the first TCP client on Node 1.
-        BulkSendHelper tcpClientHelper1("ns3::TcpSocketFactory", serverAddr1);
-        tcpClientHelper1.SetAttribute("MaxBytes", UintegerValue(0));  // Unlimited data.
-        tcpClientHelper1.SetAttribute("SendSize", UintegerValue(pktSizeBytes));
-        ApplicationContainer clientApp1 = tcpClientHelper1.Install(networkNodes.Get(0));
-        clientApp1.Start(Seconds(1.0));
-        clientApp1.Stop(Seconds(simDuration));
-
-        // Configure the second TCP server on Node 2.
-        uint16_t tcpPort2 = startingPort++;
-        Address serverAddr2(InetSocketAddress(ipInterfaces.GetAddress(1), tcpPort2));
-        PacketSinkHelper tcpServerHelper2("ns3::TcpSocketFactory", serverAddr2);
-        ApplicationContainer serverApp2 = tcpServerHelper2.Install(networkNodes.Get(1));
-        serverApp2.Start(Seconds(0.0));
-        serverApp2.Stop(Seconds(simDuration));
-
-        // Configure the second TCP client on Node 1.
-        BulkSendHelper tcpClientHelper2("ns3::TcpSocketFactory", serverAddr2);
-        tcpClientHelper2.SetAttribute("MaxBytes", UintegerValue(0));  // Unlimited data.
-        tcpClientHelper2.SetAttribute("SendSize", UintegerValue(pktSizeBytes));
-        ApplicationContainer clientApp2 = tcpClientHelper2.Install(networkNodes.Get(0));
-        clientApp2.Start(Seconds(1.5));  // Delay to stagger flows.
-        clientApp2.Stop(Seconds(simDuration));
-
-        // 4. **Flow Monitoring**: Install the Flow Monitor to track statistics.
-        FlowMonitorHelper flowMonitorHelper;
-        Ptr<FlowMonitor> monitor = flowMonitorHelper.InstallAll();
-
-        // Start and stop the simulation.
-        Simulator::Stop(Seconds(simDuration));
-        Simulator::Run();
-
-        // 5. **Results Analysis**: Collect and print throughput metrics.
-        monitor->CheckForLostPackets();
-        std::map<FlowId, FlowMonitor::FlowStats> flowStatistics = monitor->GetFlowStats();
-        for (const auto &flow : flowStatistics)
+        steady.Start(steadyState,
+                     FlowMonitorCounter(monitor,
+                                        DynamicCast<Ipv4FlowClassifier>(flowMonitorHelper.GetClassifier()),
+                                        {ipInterfaces.GetAddress(0)}),
+                     Seconds(1.0),
+                     [clientApp]() { StopSenders(clientApp); });
+    }
+
+    // Optional time series of per-flow throughput
+    ScenarioTracer tracer;
+    if (!tracePrefix.empty())
+    {
+        if (!tracer.Open(TracePath(tracePrefix, point), Seconds(traceInterval)))
+        {
+            std::cerr << "Cannot write trace for " << point.delay << " " << point.rate << std::endl;
+            std::exit(1);
+        }
+        tracer.SampleThroughput(monitor);
+    }
+
+    // Optional packet capture at the sender's end of the link.
+    PacketCapture capture;
+    if (!pcapOptions.prefix.empty())
+    {
+        if (!capture.Open(TracePath(pcapOptions.prefix, point, ".pcap.gz"), pcapOptions))
         {
-            double throughputMbps = (flow.second.rxBytes * 8.0) / simDuration / 1e6;  // Convert to Mbps.
-            std::cout << "Latency: " << delay << " - Flow ID: " << flow.first
-                      << " Throughput: " << throughputMbps << " Mbps" << std::endl;
+            std::cerr << "Cannot write capture for " << point.delay << " " << point.rate << std::endl;
+            std::exit(1);
         }
+        capture.Attach(p2pDevices.Get(0));
+    }
 
-        // 6. **Cleanup**: Destroy the simulation objects.
-        Simulator::Destroy();
+    // Start and stop the simulation.
+    Simulator::Stop(Seconds(stopSeconds));
+    profile.RunStarting();
+    Simulator::Run();
+    profile.RunFinished();
+
+    // 5. **Results Analysis**: Print throughput, loss, delay and jitter per flow.
+    ReportFlows(resultFormat, point, monitor);
+
+    if (steadyState.enabled)
+    {
+        steady.Report(point);
+    }
+    if (perfReport)
+    {
+        profile.Report(point);
+    }
+    if (!pcapOptions.prefix.empty())
+    {
+        capture.Finish(point);
+    }
+
+    // 6. **Cleanup**: Destroy the simulation objects.
+    Simulator::Destroy();
+}
+
+int main(int argc, char *argv[])
+{
+    // Sweep grid: every combination of these comma-separated lists is simulated.
+    std::string linkRate = "5Mbps";                             // Bandwidth(s) for the Point-to-Point link.
+    std::string delayOptions = "10ms,50ms,100ms,200ms,500ms";   // Latency options to test.
+    std::string seeds = "1";                                    // RNG seeds.
+    std::string format = "table";                               // Result format.
+    int jobs = 0;                                               // Parallel workers, 0 = one per CPU.
+
+    // Allow customization of the sweep and the traffic from the command line.
+    CommandLine cmd;
+    cmd.AddValue("linkRate", "Comma-separated data rates for the Point-to-Point link", linkRate);
+    cmd.AddValue("delayOptions", "Comma-separated link delays to sweep", delayOptions);
+    cmd.AddValue("seeds", "Comma-separated RNG seeds to sweep", seeds);
+    cmd.AddValue("jobs", "Sweep points simulated in parallel (0 = one per CPU)", jobs);
+    cmd.AddValue("offeredLoad", "Rate the UDP sender offers", offeredLoad);
+    cmd.AddValue("packetSize", "Size of packets sent (in bytes)", pktSizeBytes);
+    cmd.AddValue("duration", "Duration of each simulation (seconds)", simDuration);
+    cmd.AddValue("trace", "Write a time-series trace per point to PREFIX-<delay>-<rate>-s<seed>.trace", tracePrefix);
+    cmd.AddValue("traceInterval", "Throughput sampling period of the trace (seconds)", traceInterval);
+    cmd.AddValue("format", "Result format: table, csv or json (one object per line)", format);
+    cmd.AddValue("perf", "Report setup and run wall time, events/s and peak RSS per point on stderr", perfReport);
+    AddSteadyStateOptions(cmd, steadyState);
+    AddPcapOptions(cmd, pcapOptions);
+    cmd.Parse(argc, argv);
+    if (!ParseResultFormat(format, resultFormat))
+    {
+        std::cerr << "Unknown format " << format << " (expected table, csv or json)" << std::endl;
+        return 1;
     }
 
-    return 0;
+    std::vector<SweepPoint> points = MakeSweepGrid(delayOptions, linkRate, seeds);
+    PrintResultHeader(resultFormat, FlowColumns());
+    return RunSweep(points, jobs, RunUdpPoint) ? 1 : 0;
 }
@@ -0,0 +1,134 @@
+// Log-bucketed histogram in the spirit of HdrHistogram. Values are grouped
+// by their highest set bit and every power of two is split into
+// SUB_BUCKETS linear slots, so recording is a couple of bit operations and
+// any reported percentile is within 1/SUB_BUCKETS (~3%) of the true value,
+// from nanoseconds up to the full 64-bit range, in a fixed 15 KB table.
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+struct Histogram {
+    static const int SUB_BITS = 5;
+    static const int SUB_BUCKETS = 1 << SUB_BITS;
+    static const int SLOTS = (64 - SUB_BITS + 1) * SUB_BUCKETS;
+
+    uint64_t counts[SLOTS];
+    uint64_t total;
+    uint64_t min, max;
+    double sum;
+
+    Histogram() { reset(); }
+
+    void reset() {
+        memset(counts, 0, sizeof(counts));
+        total = 0;
+        min = UINT64_MAX;
+        max = 0;
+        sum = 0;
+    }
+
+    static int slot(uint64_t value) {
+        if (value < (uint64_t)SUB_BUCKETS)
+            return (int)value;
+        int shift = 63 - __builtin_clzll(value) - SUB_BITS;
+        return (shift + 1) * SUB_BUCKETS + (int)((value >> shift) & (SUB_BUCKETS - 1));
+    }
+
+    // Largest value that maps to `index`.
+    static uint64_t slot_high(int index) {
+        int bucket = index / SUB_BUCKETS, sub = index % SUB_BUCKETS;
+        if (bucket == 0)
+            return sub;
+        int shift = bucket - 1;
+        return (((uint64_t)(SUB_BUCKETS + sub) + 1) << shift) - 1;
+    }
+
+    void record(uint64_t value, uint64_t n = 1) {
+        counts[slot(value)] += n;
+        total += n;
+        sum += (double)value * n;
+        if (value < min)
+            min = value;
+        if (value > max)
+            max = value;
+    }
+
+    void merge(const Histogram &other) {
+        for (int i = 0; i < SLOTS; i++)
+            counts[i] += other.counts[i];
+        total += other.total;
+        sum += other.sum;
+        if (other.min < min)
+            min = other.min;
+        if (other.max > max)
+            max = other.max;
+    }
+
+    double mean() const { return total ? sum / total : 0; }
+
+    // Smallest recorded value v such that at least `pct` percent of the
+    // recorded values are <= v (to the histogram's precision).
+    uint64_t percentile(double pct) const {
+        if (total == 0)
+            return 0;
+        uint64_t rank = (uint64_t)(pct / 100.0 * total + 0.5);
+        if (rank < 1)
+            rank = 1;
+        uint64_t seen = 0;
+        for (int i = 0; i < SLOTS; i++) {
+            seen += counts[i];
+            if (seen >= rank) {
+                uint64_t v = slot_high(i);
+                return v < max ? v : max;
+            }
+        }
+        return max;
+    }
+};
+
+// The same buckets with relaxed atomic counters, for a histogram that
+// worker threads record into while another thread reads it. Recording
+// never blocks and snapshot() never stalls a writer; a snapshot taken
+// mid-record may simply miss that one value.
+struct AtomicHistogram {
+    std::atomic<uint64_t> counts[Histogram::SLOTS];
+    std::atomic<uint64_t> sum{0};
+    std::atomic<uint64_t> max{0};
+
+    AtomicHistogram() {
+        for (auto &c : counts)
+            c.store(0, std::memory_order_relaxed);
+    }
+
+    // Safe from any number of threads.
+    void record(uint64_t value, uint64_t n = 1) {
+        counts[Histogram::slot(value)].fetch_add(n, std::memory_order_relaxed);
+        sum.fetch_add(value * n, std::memory_order_relaxed);
+        uint64_t seen = max.load(std::memory_order_relaxed);
+        while (value > seen && !max.compare_exchange_weak(seen, value, std::memory_order_relaxed))
+            ;
+    }
+
+    // Add the current contents to `h`.
+    void snapshot(Histogram &h) const {
+        for (int i = 0; i < Histogram::SLOTS; i++) {
+            uint64_t n = counts[i].load(std::memory_order_relaxed);
+            if (n == 0)
+                continue;
+            uint64_t low = i ? Histogram::slot_high(i - 1) + 1 : 0;
+            if (low < h.min)
+                h.min = low;
+            h.counts[i] += n;
+            h.total += n;
+        }
+        h.sum += (double)sum.load(std::memory_order_relaxed);
+        uint64_t m = max.load(std::memory_order_relaxed);
+        if (m > h.max)
+            h.max = m;
+    }
+};
+
+#endif
@@ -0,0 +1,84 @@
+#! /usr/bin/env python3
+# Speedup of a distributed final_dumbbell run over the serial one. Runs the
+# same point once without MPI and once under `mpirun -np P` for every P
+# given, checks that each distributed row is identical to the serial row,
+# and prints the simulator run time and speedup per process count. Needs
+# ns-3 configured with --enable-mpi and final_dumbbell.cpp built in
+# scratch/ (see README.md).
+import os
+import re
+import sys
+import subprocess
+from optparse import OptionParser
+
+PERF_RUN = re.compile(r"^perf .* run_s=([0-9.]+) events=([0-9]+) .* peak_rss_kb=([0-9]+)",
+                      re.MULTILINE)
+
+
+def run_dumbbell(options, procs):
+    """Run the point on `procs` processes (0 = serial); returns (row, run s, events, RSS KB)."""
+    args = " ".join(["--senders=%d" % options.senders, "--receivers=%d" % options.receivers,
+                     "--duration=%g" % options.duration, "--seeds=%d" % options.seed,
+                     "--format=csv", "--perf"] + options.extra.split())
+    if procs:
+        command = [os.path.join(".", "ns3"), "run", "--no-build", "scratch/final_dumbbell",
+                   "--command-template=%s -np %d %%s --distributed --simulator=%s %s" %
+                   (options.mpirun, procs, options.simulator, args)]
+    else:
+        command = [os.path.join(".", "ns3"), "run", "--no-build",
+                   "scratch/final_dumbbell --jobs=1 " + args]
+    result = subprocess.run(command, cwd=options.ns3_dir, stdout=subprocess.PIPE,
+                            stderr=subprocess.PIPE)
+    out, err = result.stdout.decode(), result.stderr.decode()
+    perf = PERF_RUN.search(err)
+    if result.returncode != 0 or not perf:
+        sys.stderr.write(err)
+        raise RuntimeError("final_dumbbell on %d process(es) failed" % max(procs, 1))
+    row = out.strip().splitlines()[-1]
+    return row, float(perf.group(1)), int(perf.group(2)), int(perf.group(3))
+
+
+def main(argv):
+    parser = OptionParser(usage="%prog [options]")
+    parser.add_option('--ns3-dir', default=".", dest='ns3_dir',
+                      help="ns-3 tree the scenario is built in")
+    parser.add_option('--procs', default="2,4,8", dest='procs',
+                      help="Comma-separated MPI process counts")
+    parser.add_option('--mpirun', default="mpirun", dest='mpirun',
+                      help="MPI launcher")
+    parser.add_option('--simulator', default="nullmsg", dest='simulator',
+                      help="Distributed synchronization: nullmsg or barrier")
+    parser.add_option('--senders', type="int", default=1000, dest='senders',
+                      help="Senders N of the dumbbell")
+    parser.add_option('--receivers', type="int", default=100, dest='receivers',
+                      help="Receivers M of the dumbbell")
+    parser.add_option('--duration', type="float", default=10.0, dest='duration',
+                      help="Simulated seconds")
+    parser.add_option('--seed', type="int", default=1, dest='seed',
+                      help="RNG seed")
+    parser.add_option('--extra', default="", dest='extra',
+                      help="More final_dumbbell options, e.g. \"--queueDisc=FqCoDel\"")
+    (options, args) = parser.parse_args(argv[1:])
+    if args:
+        parser.error("unexpected arguments")
+
+    serial_row, serial_run, serial_events, serial_rss = run_dumbbell(options, 0)
+    print("%6s %10s %9s %12s %12s  %s" % ("procs", "run(s)", "speedup", "events", "max RSS(MB)",
+                                          "result"))
+    print("%6s %10.3f %9.2f %12d %12.1f  %s" % ("serial", serial_run, 1.0, serial_events,
+                                                serial_rss / 1024.0, "-"))
+    mismatches = 0
+    for procs in [int(p) for p in options.procs.split(",") if p]:
+        row, run, events, rss = run_dumbbell(options, procs)
+        same = row == serial_row
+        mismatches += not same
+        print("%6d %10.3f %9.2f %12d %12.1f  %s" % (procs, run, serial_run / run if run > 0 else 0,
+                                                    events, rss / 1024.0,
+                                                    "matches serial" if same else "DIFFERS: " + row))
+    if mismatches:
+        print("serial: " + serial_row)
+    return 1 if mismatches else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
@@ -0,0 +1,112 @@
+// Time-series tracing for the ns-3 scenarios. A ScenarioTracer samples
+// every flow's throughput from FlowMonitor once per interval and records
+// each change of a TCP sender's CongestionWindow and RTT trace sources
+// into a TraceWriter (tracefile.h). Scenarios only create one when
+// --trace is given; otherwise no sampling event is scheduled and no trace
+// source is connected, so a run without tracing is unaffected.
+#ifndef NSTRACE_H
+#define NSTRACE_H
+
+#include "ns3/core-module.h"
+#include "ns3/flow-monitor-module.h"
+#include "ns3/internet-module.h"
+
+#include <cctype>
+#include <map>
+#include <set>
+#include <string>
+
+#include "sweep.h"
+#include "tracefile.h"
+
+// File a sweep worker traces into: one per point, named after it.
+// Characters of the variant that do not belong in a file name become '_'.
+inline std::string
+TracePath(const std::string &prefix, const SweepPoint &point, const std::string &extension = ".trace")
+{
+    std::string variant;
+    for (char c : point.variant)
+    {
+        variant += std::isalnum((unsigned char)c) ? c : '_';
+    }
+    return prefix + "-" + point.delay + "-" + point.rate + (variant.empty() ? "" : "-" + variant) + "-s" +
+           std::to_string(point.seed) + extension;
+}
+
+class ScenarioTracer
+{
+  public:
+    bool Open(const std::string &path, ns3::Time interval)
+    {
+        m_interval = interval;
+        return m_writer.Open(path.c_str());
+    }
+
+    // Sample the throughput of every flow the monitor sees, starting one
+    // interval from now.
+    void SampleThroughput(ns3::Ptr<ns3::FlowMonitor> monitor)
+    {
+        m_monitor = monitor;
+        ns3::Simulator::Schedule(m_interval, &ScenarioTracer::Sample, this);
+    }
+
+    // Trace the TCP sockets that exist on `node` just after `when`, i.e.
+    // those a sender application creates when it starts then. Sockets are
+    // numbered from 1 in the order they are hooked.
+    void TraceTcpSocketsAt(ns3::Ptr<ns3::Node> node, ns3::Time when)
+    {
+        ns3::Simulator::Schedule(when - ns3::Simulator::Now() + ns3::NanoSeconds(1),
+                                 &ScenarioTracer::HookSockets, this, node->GetId());
+    }
+
+  private:
+    void Sample()
+    {
+        double now = ns3::Simulator::Now().GetSeconds();
+        for (const auto &flow : m_monitor->GetFlowStats())
+        {
+            uint64_t &last = m_lastRxBytes[flow.first];
+            double mbps = (flow.second.rxBytes - last) * 8.0 / m_interval.GetSeconds() / 1e6;
+            last = flow.second.rxBytes;
+            m_writer.Record(now, TRACE_THROUGHPUT, flow.first, mbps);
+        }
+        ns3::Simulator::Schedule(m_interval, &ScenarioTracer::Sample, this);
+    }
+
+    void HookSockets(uint32_t nodeId)
+    {
+        ns3::Config::MatchContainer sockets = ns3::Config::LookupMatches(
+            "/NodeList/" + std::to_string(nodeId) + "/$ns3::TcpL4Protocol/SocketList/*");
+        for (uint32_t i = 0; i < sockets.GetN(); i++)
+        {
+            ns3::Ptr<ns3::Object> socket = sockets.Get(i);
+            if (!m_hooked.insert(ns3::PeekPointer(socket)).second)
+            {
+                continue;
+            }
+            uint32_t id = m_hooked.size();
+            socket->TraceConnectWithoutContext(
+                "CongestionWindow", ns3::MakeBoundCallback(&ScenarioTracer::OnCwnd, this, id));
+            socket->TraceConnectWithoutContext(
+                "RTT", ns3::MakeBoundCallback(&ScenarioTracer::OnRtt, this, id));
+        }
+    }
+
+    static void OnCwnd(ScenarioTracer *tracer, uint32_t id, uint32_t, uint32_t cwnd)
+    {
+        tracer->m_writer.Record(ns3::Simulator::Now().GetSeconds(), TRACE_CWND, id, cwnd);
+    }
+
+    static void OnRtt(ScenarioTracer *tracer, uint32_t id, ns3::Time, ns3::Time rtt)
+    {
+        tracer->m_writer.Record(ns3::Simulator::Now().GetSeconds(), TRACE_RTT, id, rtt.GetSeconds());
+    }
+
+    TraceWriter m_writer;
+    ns3::Time m_interval;
+    ns3::Ptr<ns3::FlowMonitor> m_monitor;
+    std::map<ns3::FlowId, uint64_t> m_lastRxBytes;
+    std::set<ns3::Object *> m_hooked;
+};
+
+#endif
@@ -0,0 +1,339 @@
+// Opt-in packet capture for the ns-3 scenarios (--pcap=PREFIX). Where
+// PointToPointHelper::EnablePcapAll would write every packet to disk from
+// inside the event loop, a PacketCapture only copies each packet's first
+// --pcapSnapLen bytes into an in-memory block. Full blocks go to a writer
+// thread, which feeds them to a `gzip -1` child process, so neither the
+// file I/O nor the compression runs on the simulator's thread. The
+// simulator only waits when every block is queued, and such stalls are
+// counted.
+//
+// --pcapPort keeps only TCP/UDP packets to or from one port (one flow
+// direction pair in these scenarios). --pcapSample=N keeps every Nth
+// packet that passes the filter. The output is a standard nanosecond pcap
+// file of PPP frames, e.g.
+//
+//     zcat run-200ms-5Mbps-s1.pcap.gz | tcpdump -r - -nn
+//
+// Finish() prints one "pcap key=value ..." line on stderr per point, like
+// the perf lines of simperf.h. simbench.py --pcap compares runs with and
+// without capture to measure the slowdown.
+#ifndef PCAPTURE_H
+#define PCAPTURE_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "sweep.h"
+
+#define PCAP_BLOCK_SIZE (256 << 10)    // bytes handed to the writer at a time
+#define PCAP_BLOCKS 32                 // blocks in memory: queued, being written or filling
+#define PCAP_FILTER_BYTES 64           // PPP + IPv4 + ports, copied even below the snap length
+
+struct PcapOptions
+{
+    std::string prefix;        // capture files, off when empty
+    uint32_t snapLen = 128;    // bytes kept of each packet
+    uint32_t sample = 1;       // keep 1 in N packets
+    uint32_t port = 0;         // keep only TCP/UDP packets to or from this port, 0 = all
+};
+
+inline void
+AddPcapOptions(ns3::CommandLine &cmd, PcapOptions &opts)
+{
+    cmd.AddValue("pcap", "Capture the sender's end of the link to PREFIX-<point>.pcap.gz", opts.prefix);
+    cmd.AddValue("pcapSnapLen", "Bytes of each packet kept in the capture", opts.snapLen);
+    cmd.AddValue("pcapSample", "Keep one in N captured packets", opts.sample);
+    cmd.AddValue("pcapPort", "Capture only TCP/UDP packets to or from this port (0 = all)", opts.port);
+}
+
+class PacketCapture
+{
+  public:
+    PacketCapture() = default;
+    PacketCapture(const PacketCapture &) = delete;
+    PacketCapture &operator=(const PacketCapture &) = delete;
+
+    ~PacketCapture()
+    {
+        Close();
+    }
+
+    // Start the compressor writing to `path` and the writer thread feeding
+    // it. Returns false if either cannot be started.
+    bool Open(const std::string &path, const PcapOptions &opts)
+    {
+        m_opts = opts;
+        m_opts.sample = std::max(opts.sample, 1u);
+        m_path = path;
+        int file = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        int fds[2];
+        if (file < 0 || pipe(fds) < 0)
+        {
+            if (file >= 0)
+            {
+                close(file);
+            }
+            return false;
+        }
+        m_compressor = fork();
+        if (m_compressor == 0)
+        {
+            dup2(fds[0], 0);
+            dup2(file, 1);
+            close(fds[0]);
+            close(fds[1]);
+            close(file);
+            execlp("gzip", "gzip", "-1", "-c", (char *)nullptr);
+            _exit(127);
+        }
+        close(fds[0]);
+        close(file);
+        if (m_compressor < 0)
+        {
+            close(fds[1]);
+            return false;
+        }
+        // A compressor that dies shows up as a failed write, not a signal
+        signal(SIGPIPE, SIG_IGN);
+        m_pipe = fds[1];
+
+        for (int i = 0; i < PCAP_BLOCKS; i++)
+        {
+            m_blocks.emplace_back(new Block);
+            m_free.push_back(m_blocks.back().get());
+        }
+        m_current = TakeFreeBlock();
+        WriteFileHeader();
+        m_writer = std::thread(&PacketCapture::WriterLoop, this);
+        return true;
+    }
+
+    // Capture every packet `device` sends or receives.
+    void Attach(ns3::Ptr<ns3::NetDevice> device)
+    {
+        device->TraceConnectWithoutContext("Sniffer", ns3::MakeCallback(&PacketCapture::Capture, this));
+    }
+
+    // Flush the last block, wait for the writer and the compressor, and
+    // report the capture on stderr.
+    void Finish(const SweepPoint &point)
+    {
+        Close();
+        struct stat st;
+        uint64_t fileBytes = stat(m_path.c_str(), &st) == 0 ? st.st_size : 0;
+
+        std::ostringstream line;
+        line << "pcap delay=" << point.delay << " rate=" << point.rate << " seed=" << point.seed;
+        if (!point.variant.empty())
+        {
+            line << " variant=" << point.variant;
+        }
+        line << " seen=" << m_seen << " matched=" << m_matched << " captured=" << m_captured
+             << " raw_bytes=" << m_rawBytes << " file_bytes=" << fileBytes << " stalls=" << m_stalls
+             << std::fixed << std::setprecision(3) << " stall_ms=" << m_stallSeconds * 1e3
+             << " writer_s=" << m_writerSeconds << " ok=" << (m_failed ? 0 : 1) << "\n";
+        std::cerr << line.str() << std::flush;
+    }
+
+  private:
+    struct Block
+    {
+        char data[PCAP_BLOCK_SIZE];
+        size_t used = 0;
+    };
+
+    using Clock = std::chrono::steady_clock;
+
+    void Capture(ns3::Ptr<const ns3::Packet> packet)
+    {
+        m_seen++;
+        uint32_t size = packet->GetSize();
+        uint32_t kept = std::min(size, m_opts.snapLen);
+        uint32_t copied = std::min(size, std::max<uint32_t>(m_opts.snapLen, PCAP_FILTER_BYTES));
+        if (m_current->used + 16 + copied > PCAP_BLOCK_SIZE)
+        {
+            HandOff();
+        }
+
+        // Copy straight into the block; a packet that is filtered out is
+        // simply overwritten by the next one.
+        char *record = m_current->data + m_current->used;
+        packet->CopyData((uint8_t *)record + 16, copied);
+        if (m_opts.port && !MatchesPort((const uint8_t *)record + 16, copied))
+        {
+            return;
+        }
+        if (m_matched++ % m_opts.sample != 0)
+        {
+            return;
+        }
+
+        uint64_t ns = ns3::Simulator::Now().GetNanoSeconds();
+        uint32_t header[4] = {(uint32_t)(ns / 1000000000), (uint32_t)(ns % 1000000000), kept, size};
+        std::memcpy(record, header, sizeof(header));
+        m_current->used += 16 + kept;
+        m_captured++;
+        m_rawBytes += 16 + kept;
+    }
+
+    // PPP-framed IPv4 carrying TCP or UDP with `port` at either end.
+    bool MatchesPort(const uint8_t *frame, uint32_t len) const
+    {
+        if (len < 2 + 20 || frame[0] != 0x00 || frame[1] != 0x21)
+        {
+            return false;
+        }
+        const uint8_t *ip = frame + 2;
+        uint32_t ihl = (ip[0] & 0x0f) * 4;
+        if ((ip[9] != 6 && ip[9] != 17) || len < 2 + ihl + 4)
+        {
+            return false;
+        }
+        uint16_t source = ip[ihl] << 8 | ip[ihl + 1];
+        uint16_t destination = ip[ihl + 2] << 8 | ip[ihl + 3];
+        return source == m_opts.port || destination == m_opts.port;
+    }
+
+    void WriteFileHeader()
+    {
+        // Nanosecond-resolution pcap, link type PPP (as the p2p devices frame)
+        uint32_t header[6] = {0xa1b23c4d, 2 | 4u << 16, 0, 0, m_opts.snapLen, 9};
+        std::memcpy(m_current->data, header, sizeof(header));
+        m_current->used = sizeof(header);
+    }
+
+    Block *TakeFreeBlock()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_free.empty())
+        {
+            Clock::time_point start = Clock::now();
+            m_stalls++;
+            m_cond.wait(lock, [this]() { return !m_free.empty(); });
+            m_stallSeconds += std::chrono::duration<double>(Clock::now() - start).count();
+        }
+        Block *block = m_free.back();
+        m_free.pop_back();
+        block->used = 0;
+        return block;
+    }
+
+    // Queue the current block for the writer and start filling another.
+    void HandOff()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_queued.push_back(m_current);
+        }
+        m_cond.notify_all();
+        m_current = TakeFreeBlock();
+    }
+
+    void WriterLoop()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true)
+        {
+            m_cond.wait(lock, [this]() { return !m_queued.empty() || m_closing; });
+            if (m_queued.empty())
+            {
+                return;
+            }
+            Block *block = m_queued.front();
+            m_queued.pop_front();
+            lock.unlock();
+
+            Clock::time_point start = Clock::now();
+            size_t written = 0;
+            while (!m_failed && written < block->used)
+            {
+                ssize_t n = write(m_pipe, block->data + written, block->used - written);
+                if (n < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                if (n <= 0)
+                {
+                    m_failed = true;
+                    break;
+                }
+                written += n;
+            }
+            m_writerSeconds += std::chrono::duration<double>(Clock::now() - start).count();
+
+            lock.lock();
+            m_free.push_back(block);
+            m_cond.notify_all();
+        }
+    }
+
+    void Close()
+    {
+        if (m_pipe < 0)
+        {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_queued.push_back(m_current);
+            m_current = nullptr;
+            m_closing = true;
+        }
+        m_cond.notify_all();
+        m_writer.join();
+        close(m_pipe);
+        m_pipe = -1;
+        int status;
+        if (waitpid(m_compressor, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            m_failed = true;
+        }
+    }
+
+    PcapOptions m_opts;
+    std::string m_path;
+    int m_pipe = -1;
+    pid_t m_compressor = -1;
+    std::thread m_writer;
+
+    // Blocks move from m_free to m_current (simulator thread) to m_queued
+    // to the writer and back; the lists are guarded by m_mutex.
+    std::vector<std::unique_ptr<Block>> m_blocks;
+    std::vector<Block *> m_free;
+    std::deque<Block *> m_queued;
+    Block *m_current = nullptr;
+    bool m_closing = false;
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+
+    // Simulator thread
+    uint64_t m_seen = 0, m_matched = 0, m_captured = 0, m_rawBytes = 0;
+    uint64_t m_stalls = 0;
+    double m_stallSeconds = 0;
+
+    // Writer thread; read after it has been joined
+    double m_writerSeconds = 0;
+    bool m_failed = false;
+};
+
+#endif
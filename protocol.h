@@ -0,0 +1,124 @@
+// Wire format shared by server.cpp, client.cpp and the benchmarks.
+//
+// Every message is a frame:
+//
+//     varint length | opcode (1 byte) | payload (length - 1 bytes)
+//
+// `length` counts the opcode and payload and is encoded as an unsigned
+// LEB128 varint, so short messages cost two bytes of header. TCP is free
+// to merge or split writes; readers accumulate bytes and peel off as many
+// complete frames as are available.
+//
+// Over UDP (server -u, client -u) every datagram holds exactly one frame
+// and requests carry a sequence number, echoed in the reply, so the client
+// can tell lost and reordered datagrams apart.
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#define MAX_FRAME_SIZE (1 << 20)
+#define MAX_VARINT_BYTES 10
+
+// Client -> server
+#define OP_MESSAGE      1   // payload is the text typed by the user; "Quit" ends the session
+#define OP_BULK_REQUEST 3   // payload is a varint byte count (0 = server's default size)
+#define OP_DGRAM_MESSAGE 5  // UDP: DGRAM_SEQ_BYTES sequence number, then the text
+// Server -> client
+#define OP_REPLY        2   // payload is "OK" or "Goodbye"
+#define OP_BULK_START   4   // payload is a varint byte count; that many raw,
+                            // unframed bytes follow before the next frame
+#define OP_DGRAM_REPLY  6   // UDP: the request's sequence number, then "OK" or "Goodbye"
+
+#define DGRAM_SEQ_BYTES 8   // little-endian uint64
+
+struct Frame {
+    uint8_t opcode;
+    const char *payload;
+    size_t length;      // payload bytes
+};
+
+inline size_t encode_varint(uint64_t value, char *out) {
+    size_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = (char)((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (char)value;
+    return n;
+}
+
+#define MAX_FRAME_HEADER (MAX_VARINT_BYTES + 1)
+
+// Writes the length and opcode of a frame with a `length`-byte payload;
+// returns the header size (at most MAX_FRAME_HEADER).
+inline size_t encode_frame_header(char *out, uint8_t opcode, size_t length) {
+    size_t n = encode_varint(length + 1, out);
+    out[n++] = (char)opcode;
+    return n;
+}
+
+inline void append_frame(std::string &out, uint8_t opcode, const char *payload, size_t length) {
+    char header[MAX_FRAME_HEADER];
+    out.append(header, encode_frame_header(header, opcode, length));
+    out.append(payload, length);
+}
+
+inline void append_frame(std::string &out, uint8_t opcode, const std::string &payload) {
+    append_frame(out, opcode, payload.data(), payload.size());
+}
+
+// Decodes the varint at the start of buf. Returns the bytes it occupies,
+// 0 if buf ends inside it, or -1 if it is longer than MAX_VARINT_BYTES.
+inline long decode_varint(const char *buf, size_t len, uint64_t &value) {
+    value = 0;
+    for (size_t pos = 0; pos < MAX_VARINT_BYTES; pos++) {
+        if (pos == len)
+            return 0;
+        uint8_t byte = (uint8_t)buf[pos];
+        value |= (uint64_t)(byte & 0x7f) << (7 * pos);
+        if (!(byte & 0x80))
+            return (long)pos + 1;
+    }
+    return -1;
+}
+
+inline void append_varint_frame(std::string &out, uint8_t opcode, uint64_t value) {
+    char payload[MAX_VARINT_BYTES];
+    append_frame(out, opcode, payload, encode_varint(value, payload));
+}
+
+inline void encode_seq(uint64_t seq, char *out) {
+    for (int i = 0; i < DGRAM_SEQ_BYTES; i++)
+        out[i] = (char)(seq >> (8 * i));
+}
+
+inline uint64_t decode_seq(const char *in) {
+    uint64_t seq = 0;
+    for (int i = 0; i < DGRAM_SEQ_BYTES; i++)
+        seq |= (uint64_t)(uint8_t)in[i] << (8 * i);
+    return seq;
+}
+
+// Decodes the frame at the start of buf. Returns the number of bytes it
+// occupies, 0 if more bytes are needed, or -1 if the stream is corrupt
+// (bad varint, empty frame or a length above MAX_FRAME_SIZE).
+inline long parse_frame(const char *buf, size_t len, Frame &frame) {
+    uint64_t length;
+    long pos = decode_varint(buf, len, length);
+    if (pos <= 0)
+        return pos;
+    if (length == 0 || length > MAX_FRAME_SIZE)
+        return -1;
+    if (len - pos < length)
+        return 0;
+
+    frame.opcode = (uint8_t)buf[pos];
+    frame.payload = buf + pos + 1;
+    frame.length = length - 1;
+    return (long)(pos + length);
+}
+
+#endif
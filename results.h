@@ -0,0 +1,561 @@
+// Per-flow results for every ns-3 scenario, computed one way from
+// FlowMonitor statistics so that numbers from different binaries compare:
+//
+//   throughput  IP bytes received * 8 / (last reception - first
+//               transmission), in Mbps (1e6 bit/s)
+//   loss        packets sent but not received, as a share of those sent
+//               (packets still in flight when the simulation stops count)
+//   delay       one-way delay: mean and p50/p95/p99 from delayHistogram
+//   jitter      delay difference between consecutive packets: mean and
+//               p50/p95/p99 from jitterHistogram
+//
+// Percentiles are the upper edge of the histogram bin they fall in, so
+// they are exact to within RESULTS_BIN_WIDTH. Rows are printed as an
+// aligned table, CSV, or JSON lines (one object per flow).
+//
+// Scenarios with competing flows can instead report one fairness row per
+// run (FairnessSampler below):
+//
+//   jain         Jain's index (sum x)^2 / (n * sum x^2) of the flows'
+//                throughput while all of them are active
+//   utilization  bytes all flows delivered since the first one started,
+//                as a share of what the bottleneck could have carried
+//   convergence  time from the last flow's start until Jain's index over
+//                every following sampling interval stays >= the threshold
+//                (-1 if it never settles)
+//
+// and single-flow TCP scenarios can report one row per run comparing the
+// flow's throughput with what its window allows on the path (tcpbdp.h).
+#ifndef RESULTS_H
+#define RESULTS_H
+
+#include "ns3/flow-monitor-module.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "sweep.h"
+#include "tcpbdp.h"
+
+#define RESULTS_BIN_WIDTH 0.0001   // seconds, for the delay and jitter histograms
+#define RESULTS_VARIANT_WIDTH 24   // table column width of SweepPoint::variant
+
+enum ResultFormat
+{
+    RESULTS_TABLE,
+    RESULTS_CSV,
+    RESULTS_JSON,
+};
+
+struct FlowResult
+{
+    SweepPoint point;
+    ns3::FlowId flow;
+    uint64_t txPackets, rxPackets;
+    double throughputMbps;
+    double lossPercent;
+    double delayMeanMs, delayP50Ms, delayP95Ms, delayP99Ms;
+    double jitterMeanMs, jitterP50Ms, jitterP95Ms, jitterP99Ms;
+};
+
+struct FairnessResult
+{
+    SweepPoint point;
+    uint32_t flows;
+    double totalMbps, minFlowMbps, maxFlowMbps;
+    double jainIndex;
+    double utilizationPercent;
+    double convergenceSeconds;  // -1 if the flows never converged
+};
+
+struct BdpResult
+{
+    SweepPoint point;
+    std::string buffers;  // "default" or "bdp"
+    TcpPlan plan;
+    double theoreticalMbps, achievedMbps;
+};
+
+inline bool
+ParseResultFormat(const std::string &name, ResultFormat &format)
+{
+    if (name == "table")
+    {
+        format = RESULTS_TABLE;
+    }
+    else if (name == "csv")
+    {
+        format = RESULTS_CSV;
+    }
+    else if (name == "json")
+    {
+        format = RESULTS_JSON;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+// Finer histogram bins than FlowMonitor's 1 ms default, so that
+// percentiles of short delays mean something. Call before InstallAll().
+inline void
+ConfigureFlowMonitor(ns3::FlowMonitorHelper &helper)
+{
+    helper.SetMonitorAttribute("DelayBinWidth", ns3::DoubleValue(RESULTS_BIN_WIDTH));
+    helper.SetMonitorAttribute("JitterBinWidth", ns3::DoubleValue(RESULTS_BIN_WIDTH));
+}
+
+// Smallest bin upper edge below which `percent` of the samples fall.
+inline double
+HistogramPercentile(const ns3::Histogram &histogram, double percent)
+{
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < histogram.GetNBins(); i++)
+    {
+        total += histogram.GetBinCount(i);
+    }
+    if (total == 0)
+    {
+        return 0;
+    }
+
+    uint64_t target = (uint64_t)std::ceil(total * percent / 100.0);
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < histogram.GetNBins(); i++)
+    {
+        seen += histogram.GetBinCount(i);
+        if (seen >= target)
+        {
+            return histogram.GetBinEnd(i);
+        }
+    }
+    return histogram.GetBinEnd(histogram.GetNBins() - 1);
+}
+
+inline FlowResult
+ComputeFlowResult(const SweepPoint &point, ns3::FlowId id, const ns3::FlowMonitor::FlowStats &stats)
+{
+    FlowResult r;
+    r.point = point;
+    r.flow = id;
+    r.txPackets = stats.txPackets;
+    r.rxPackets = stats.rxPackets;
+
+    double active = (stats.timeLastRxPacket - stats.timeFirstTxPacket).GetSeconds();
+    r.throughputMbps = stats.rxPackets && active > 0 ? stats.rxBytes * 8.0 / active / 1e6 : 0;
+    r.lossPercent = stats.txPackets > stats.rxPackets
+                        ? 100.0 * (stats.txPackets - stats.rxPackets) / stats.txPackets
+                        : 0;
+
+    r.delayMeanMs = stats.rxPackets ? stats.delaySum.GetSeconds() / stats.rxPackets * 1e3 : 0;
+    r.delayP50Ms = HistogramPercentile(stats.delayHistogram, 50) * 1e3;
+    r.delayP95Ms = HistogramPercentile(stats.delayHistogram, 95) * 1e3;
+    r.delayP99Ms = HistogramPercentile(stats.delayHistogram, 99) * 1e3;
+
+    r.jitterMeanMs =
+        stats.rxPackets > 1 ? stats.jitterSum.GetSeconds() / (stats.rxPackets - 1) * 1e3 : 0;
+    r.jitterP50Ms = HistogramPercentile(stats.jitterHistogram, 50) * 1e3;
+    r.jitterP95Ms = HistogramPercentile(stats.jitterHistogram, 95) * 1e3;
+    r.jitterP99Ms = HistogramPercentile(stats.jitterHistogram, 99) * 1e3;
+    return r;
+}
+
+// One field of a result row. Each kind of result lists its fields once, in
+// a *Columns function, and PrintResultHeader/PrintResultRow lay them out
+// as a table, CSV or JSON. Text is quoted in JSON and shown as "-" in the
+// table when empty; reals are printed with three decimals.
+struct ResultCell
+{
+    enum Kind
+    {
+        TEXT,
+        INTEGER,
+        REAL,
+    };
+
+    const char *name;
+    int width;  // table column width
+    Kind kind;
+    std::string text;
+    uint64_t integer;
+    double real;
+};
+
+using ResultRow = std::vector<ResultCell>;
+
+inline ResultCell
+TextCell(const char *name, int width, const std::string &value)
+{
+    return {name, width, ResultCell::TEXT, value, 0, 0};
+}
+
+inline ResultCell
+IntegerCell(const char *name, int width, uint64_t value)
+{
+    return {name, width, ResultCell::INTEGER, "", value, 0};
+}
+
+inline ResultCell
+RealCell(const char *name, int width, double value)
+{
+    return {name, width, ResultCell::REAL, "", 0, value};
+}
+
+// The columns of `row`; JSON lines have no header.
+inline void
+PrintResultHeader(ResultFormat format, const ResultRow &row)
+{
+    if (format == RESULTS_JSON)
+    {
+        return;
+    }
+    for (size_t i = 0; i < row.size(); i++)
+    {
+        if (format == RESULTS_CSV)
+        {
+            std::cout << (i ? "," : "") << row[i].name;
+        }
+        else
+        {
+            std::cout << std::setw(row[i].width) << row[i].name;
+        }
+    }
+    std::cout << std::endl;
+}
+
+inline void
+PrintResultRow(ResultFormat format, const ResultRow &row)
+{
+    std::ostream &out = std::cout;
+    out << std::fixed << std::setprecision(3);
+    if (format == RESULTS_JSON)
+    {
+        out << "{";
+    }
+    for (size_t i = 0; i < row.size(); i++)
+    {
+        const ResultCell &cell = row[i];
+        bool quoted = format == RESULTS_JSON && cell.kind == ResultCell::TEXT;
+        if (format == RESULTS_JSON)
+        {
+            out << (i ? ", " : "") << "\"" << cell.name << "\": ";
+        }
+        else if (format == RESULTS_CSV)
+        {
+            out << (i ? "," : "");
+        }
+        else
+        {
+            out << std::setw(cell.width);
+        }
+
+        if (cell.kind == ResultCell::INTEGER)
+        {
+            out << cell.integer;
+        }
+        else if (cell.kind == ResultCell::REAL)
+        {
+            out << cell.real;
+        }
+        else if (quoted)
+        {
+            out << "\"" << cell.text << "\"";
+        }
+        else
+        {
+            out << (format == RESULTS_TABLE && cell.text.empty() ? "-" : cell.text);
+        }
+    }
+    if (format == RESULTS_JSON)
+    {
+        out << "}";
+    }
+    out << std::defaultfloat << std::endl;
+}
+
+// Cells naming the sweep point a row belongs to.
+inline void
+AddPointCells(ResultRow &row, const SweepPoint &point, bool withVariant)
+{
+    row.push_back(TextCell("delay", 8, point.delay));
+    row.push_back(TextCell("rate", 8, point.rate));
+    row.push_back(IntegerCell("seed", 8, point.seed));
+    if (withVariant)
+    {
+        row.push_back(TextCell("variant", RESULTS_VARIANT_WIDTH, point.variant));
+    }
+}
+
+inline ResultRow
+FlowColumns(const FlowResult &r = FlowResult())
+{
+    ResultRow row;
+    AddPointCells(row, r.point, true);
+    row.push_back(IntegerCell("flow", 8, r.flow));
+    row.push_back(IntegerCell("tx_packets", 15, r.txPackets));
+    row.push_back(IntegerCell("rx_packets", 15, r.rxPackets));
+    row.push_back(RealCell("throughput_mbps", 15, r.throughputMbps));
+    row.push_back(RealCell("loss_pct", 15, r.lossPercent));
+    row.push_back(RealCell("delay_mean_ms", 15, r.delayMeanMs));
+    row.push_back(RealCell("delay_p50_ms", 15, r.delayP50Ms));
+    row.push_back(RealCell("delay_p95_ms", 15, r.delayP95Ms));
+    row.push_back(RealCell("delay_p99_ms", 15, r.delayP99Ms));
+    row.push_back(RealCell("jitter_mean_ms", 15, r.jitterMeanMs));
+    row.push_back(RealCell("jitter_p50_ms", 15, r.jitterP50Ms));
+    row.push_back(RealCell("jitter_p95_ms", 15, r.jitterP95Ms));
+    row.push_back(RealCell("jitter_p99_ms", 15, r.jitterP99Ms));
+    return row;
+}
+
+// Print a result row for every flow the monitor saw.
+inline void
+ReportFlows(ResultFormat format, const SweepPoint &point, ns3::Ptr<ns3::FlowMonitor> monitor)
+{
+    monitor->CheckForLostPackets();
+    for (const auto &flow : monitor->GetFlowStats())
+    {
+        PrintResultRow(format, FlowColumns(ComputeFlowResult(point, flow.first, flow.second)));
+    }
+}
+
+inline double
+JainIndex(const std::vector<double> &x)
+{
+    double sum = 0, squares = 0;
+    for (double v : x)
+    {
+        sum += v;
+        squares += v * v;
+    }
+    return squares > 0 ? sum * sum / (x.size() * squares) : 0;
+}
+
+// Bytes delivered so far, per flow
+using FlowByteCounter = std::function<std::map<ns3::FlowId, uint64_t>()>;
+
+// Count the IP bytes FlowMonitor saw for the flows leaving `senders`.
+// Flows in the other direction (the ACK streams of TCP) are ignored.
+inline FlowByteCounter
+FlowMonitorCounter(ns3::Ptr<ns3::FlowMonitor> monitor,
+                   ns3::Ptr<ns3::Ipv4FlowClassifier> classifier,
+                   const std::vector<ns3::Ipv4Address> &senders)
+{
+    std::set<ns3::Ipv4Address> from(senders.begin(), senders.end());
+    return [monitor, classifier, from]() {
+        std::map<ns3::FlowId, uint64_t> bytes;
+        for (const auto &flow : monitor->GetFlowStats())
+        {
+            if (from.count(classifier->FindFlow(flow.first).sourceAddress))
+            {
+                bytes[flow.first] = flow.second.rxBytes;
+            }
+        }
+        return bytes;
+    };
+}
+
+// Samples the bytes each flow has delivered once per interval from the
+// moment all flows are active, and turns the samples into a
+// FairnessResult when the run is over.
+class FairnessSampler
+{
+  public:
+    void Start(ns3::Ptr<ns3::FlowMonitor> monitor,
+               ns3::Ptr<ns3::Ipv4FlowClassifier> classifier,
+               const std::vector<ns3::Ipv4Address> &senders,
+               ns3::Time allActive,
+               ns3::Time interval)
+    {
+        Start(FlowMonitorCounter(monitor, classifier, senders), allActive, interval);
+    }
+
+    void Start(FlowByteCounter counter, ns3::Time allActive, ns3::Time interval)
+    {
+        m_counter = counter;
+        m_interval = interval;
+        ns3::Simulator::Schedule(allActive - ns3::Simulator::Now(), &FairnessSampler::Sample, this);
+    }
+
+    // Distributed runs, after Simulator::Run(): every rank counted only the
+    // flows it receives, all over the same flow keys at the same times.
+    // `sum` adds a vector element-wise over all ranks (MPI_Allreduce).
+    void Reduce(const std::function<void(std::vector<uint64_t> &)> &sum)
+    {
+        SampleEnd();
+        std::vector<uint64_t> flat;
+        for (const auto &sample : m_samples)
+        {
+            for (const auto &flow : sample)
+            {
+                flat.push_back(flow.second);
+            }
+        }
+        sum(flat);
+        size_t i = 0;
+        for (auto &sample : m_samples)
+        {
+            for (auto &flow : sample)
+            {
+                flow.second = flat[i++];
+            }
+        }
+    }
+
+    // Call after Simulator::Run(). `firstStart` is when the first flow
+    // started, `linkBps` the bottleneck rate.
+    FairnessResult Finish(const SweepPoint &point, ns3::Time firstStart, uint64_t linkBps, double threshold)
+    {
+        SampleEnd();
+
+        FairnessResult r;
+        r.point = point;
+        r.flows = 0;
+        r.totalMbps = r.minFlowMbps = r.maxFlowMbps = r.jainIndex = r.utilizationPercent = 0;
+        r.convergenceSeconds = -1;
+        if (m_times.size() < 2)
+        {
+            return r;
+        }
+
+        // Throughput of each flow over the whole period they were all active
+        const std::map<ns3::FlowId, uint64_t> &first = m_samples.front();
+        const std::map<ns3::FlowId, uint64_t> &last = m_samples.back();
+        std::vector<double> mbps = Rates(first, last, m_times.back() - m_times.front());
+        uint64_t delivered = 0;
+        for (const auto &flow : last)
+        {
+            delivered += flow.second;
+        }
+        r.flows = mbps.size();
+        if (!mbps.empty())
+        {
+            auto range = std::minmax_element(mbps.begin(), mbps.end());
+            r.minFlowMbps = *range.first;
+            r.maxFlowMbps = *range.second;
+            r.totalMbps = std::accumulate(mbps.begin(), mbps.end(), 0.0);
+        }
+        r.jainIndex = JainIndex(mbps);
+        double since = m_times.back() - firstStart.GetSeconds();
+        r.utilizationPercent = since > 0 && linkBps ? 100.0 * delivered * 8 / since / linkBps : 0;
+
+        // Converged from the start of the first interval after which no
+        // interval is unfair any more
+        size_t settled = m_times.size() - 1;
+        while (settled > 0 &&
+               JainIndex(Rates(m_samples[settled - 1], m_samples[settled],
+                               m_times[settled] - m_times[settled - 1])) >= threshold)
+        {
+            settled--;
+        }
+        if (settled < m_times.size() - 1)
+        {
+            r.convergenceSeconds = m_times[settled] - m_times.front();
+        }
+        return r;
+    }
+
+  private:
+    void Sample()
+    {
+        m_samples.push_back(m_counter());
+        m_times.push_back(ns3::Simulator::Now().GetSeconds());
+        ns3::Simulator::Schedule(m_interval, &FairnessSampler::Sample, this);
+    }
+
+    // The last periodic sample may fall short of the stop time.
+    void SampleEnd()
+    {
+        if (m_times.empty() || m_times.back() < ns3::Simulator::Now().GetSeconds())
+        {
+            Sample();
+        }
+    }
+
+    static std::vector<double> Rates(const std::map<ns3::FlowId, uint64_t> &from,
+                                     const std::map<ns3::FlowId, uint64_t> &to,
+                                     double seconds)
+    {
+        std::vector<double> mbps;
+        for (const auto &flow : to)
+        {
+            auto before = from.find(flow.first);
+            uint64_t base = before == from.end() ? 0 : before->second;
+            mbps.push_back(seconds > 0 ? (flow.second - base) * 8.0 / seconds / 1e6 : 0);
+        }
+        return mbps;
+    }
+
+    FlowByteCounter m_counter;
+    ns3::Time m_interval;
+    std::vector<double> m_times;
+    std::vector<std::map<ns3::FlowId, uint64_t>> m_samples;
+};
+
+inline ResultRow
+FairnessColumns(const FairnessResult &r = FairnessResult())
+{
+    ResultRow row;
+    AddPointCells(row, r.point, true);
+    row.push_back(IntegerCell("flows", 8, r.flows));
+    row.push_back(RealCell("total_mbps", 16, r.totalMbps));
+    row.push_back(RealCell("min_flow_mbps", 16, r.minFlowMbps));
+    row.push_back(RealCell("max_flow_mbps", 16, r.maxFlowMbps));
+    row.push_back(RealCell("jain", 16, r.jainIndex));
+    row.push_back(RealCell("utilization_pct", 16, r.utilizationPercent));
+    row.push_back(RealCell("convergence_s", 16, r.convergenceSeconds));
+    return row;
+}
+
+inline ResultRow
+BdpColumns(const BdpResult &r = BdpResult())
+{
+    ResultRow row;
+    AddPointCells(row, r.point, false);
+    row.push_back(TextCell("buffers", 8, r.buffers));
+    row.push_back(IntegerCell("bdp_bytes", 17, r.plan.bdpBytes));
+    row.push_back(IntegerCell("buffer_bytes", 17, r.plan.bufferBytes));
+    row.push_back(IntegerCell("segment_bytes", 17, r.plan.segmentBytes));
+    row.push_back(RealCell("theoretical_mbps", 17, r.theoreticalMbps));
+    row.push_back(RealCell("achieved_mbps", 17, r.achievedMbps));
+    row.push_back(RealCell("efficiency_pct", 17,
+                           r.theoreticalMbps > 0 ? 100.0 * r.achievedMbps / r.theoreticalMbps : 0));
+    return row;
+}
+
+// Compare the flow leaving `sender` with what `plan` allows.
+inline void
+ReportBdp(ResultFormat format,
+          const SweepPoint &point,
+          const std::string &buffers,
+          const TcpPlan &plan,
+          ns3::Ptr<ns3::FlowMonitor> monitor,
+          ns3::Ptr<ns3::Ipv4FlowClassifier> classifier,
+          ns3::Ipv4Address sender)
+{
+    BdpResult r;
+    r.point = point;
+    r.buffers = buffers;
+    r.plan = plan;
+    r.theoreticalMbps = TheoreticalMbps(plan);
+    r.achievedMbps = 0;
+    for (const auto &flow : monitor->GetFlowStats())
+    {
+        if (classifier->FindFlow(flow.first).sourceAddress == sender)
+        {
+            r.achievedMbps += ComputeFlowResult(point, flow.first, flow.second).throughputMbps;
+        }
+    }
+    PrintResultRow(format, BdpColumns(r));
+}
+
+#endif
@@ -1,75 +1,1276 @@
 #include <iostream>
+#include <cinttypes>
+#include <cstdio>
 #include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <unordered_map>
+#include <pthread.h>
+#include <sched.h>
 #include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/sendfile.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <netinet/in.h>
+#include <linux/errqueue.h>
+#include <fcntl.h>
+#include <time.h>
 #include <unistd.h>
 
+#include "protocol.h"
+#include "uring.h"
+#include "bufpool.h"
+#include "histogram.h"
+#include "shmring.h"
+#include "sockbuf.h"
+#include "udp.h"
+#include "unixsock.h"
+
 #define PORT 12345
-#define BUFFER_SIZE 1024
+#define BUFFER_SIZE 16384
+#define OUTPUT_HIGH_WATER (256 << 10)   // queued reply bytes above which a connection is not read
+#define MAX_EVENTS 1024
+#define URING_ENTRIES 4096
+#define URING_BUF_COUNT 2048    // provided recv buffers per worker (power of two)
+#define URING_BUF_SIZE 4096
+#define BULK_CHUNK_SIZE (4 << 20)          // generated bulk data, reused cyclically
+#define BULK_DEFAULT_SIZE (1ULL << 30)     // bytes sent when the client asks for 0
+
+// user_data of io_uring completions: fd << 8 | operation
+#define OP_ACCEPT_DONE 1
+#define OP_RECV_DONE   2
+#define OP_SEND_DONE   3
 
 using namespace std;
 
-int main() {
-    int server_fd, new_socket;
-    struct sockaddr_in address;
-    char buffer[BUFFER_SIZE] = {0};
+// Heap allocations made by the current thread (every operator new is
+// routed through the replacement below). The message path is expected to
+// leave it untouched once the buffer pool has warmed up; workers report
+// any allocation it does make as `message_allocations`.
+static thread_local uint64_t heap_allocations = 0;
+
+void *operator new(size_t size) {
+    heap_allocations++;
+    void *p = malloc(size ? size : 1);
+    if (!p)
+        throw bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+    free(p);
+}
+
+// State the event loop keeps for every accepted socket. `in` holds bytes
+// of a frame that has not fully arrived yet; replies that could not be
+// written immediately wait in `out` until the socket becomes writable.
+// Both borrow buffers from the worker's pool only while non-empty.
+struct Connection {
+    int fd;
+    IoBuffer in{};
+    IoBuffer out{};
+    bool closing = false;   // "Goodbye" queued, close once it is flushed
+    bool read_paused = false;   // epoll: stopped reading before EAGAIN, see input_paused
+
+    // io_uring backend only: `sending` is owned by the kernel while a send
+    // is in flight, and the connection is freed once neither op is armed.
+    IoBuffer sending{};
+    bool send_inflight = false;
+    bool recv_armed = false;
+
+    // Bulk transfer in progress (epoll backend only). Requests that arrived
+    // before the stream stay in `in` until it has been sent; no more is
+    // read from the socket meanwhile.
+    uint64_t bulk_total = 0, bulk_sent = 0;
+    uint64_t bulk_start_ns = 0, bulk_cpu_start_ns = 0;
+    uint64_t zc_sends = 0, zc_completed = 0, zc_copied = 0;
+};
+
+enum BulkMode { BULK_COPY, BULK_SENDFILE, BULK_ZEROCOPY };
+
+// Where bulk data comes from; set up once in main and read-only after.
+// `fd` is the file given with -f (or a memfd holding `chunk`) for
+// sendfile; `chunk` is the generated buffer for the copy and MSG_ZEROCOPY
+// paths. The buffer is never written again, so zerocopy sends need not
+// wait for their completions before it is reused.
+struct BulkSource {
+    BulkMode mode = BULK_COPY;
+    int fd = -1;
+    uint64_t size = BULK_CHUNK_SIZE;    // file size, or size of the cycled chunk
+    bool from_file = false;
+    char *chunk = nullptr;
+};
+
+static BulkSource bulk;
+static SocketBufferSpec socket_buffers;    // -w, inherited by accepted connections
+
+static const char *bulk_mode_name(BulkMode mode) {
+    switch (mode) {
+    case BULK_SENDFILE: return "sendfile";
+    case BULK_ZEROCOPY: return "MSG_ZEROCOPY";
+    default: return "copy";
+    }
+}
+
+static uint64_t clock_ns(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Counters owned by one worker. Only the owning thread writes them, so
+// relaxed atomics are enough and the hot path never takes a lock; the
+// main thread sums them when it reports, the metrics thread (-s) whenever
+// it is asked. Each block gets its own cache line so workers do not
+// false-share.
+struct alignas(64) WorkerStats {
+    atomic<uint64_t> accepted{0};
+    atomic<uint64_t> closed{0};
+    atomic<uint64_t> messages{0};   // requests received
+    atomic<uint64_t> replies{0};
+    atomic<uint64_t> bytes_in{0};
+    atomic<uint64_t> bytes_out{0};  // request/reply traffic; bulk streams count in bulk_bytes
+    atomic<uint64_t> syscalls{0};   // I/O syscalls made by the worker
+    atomic<uint64_t> bulk_bytes{0};
+    atomic<uint64_t> message_allocations{0};  // heap allocations while handling messages
+    // Per message, from the wakeup that received it until its reply was
+    // handed to the kernel. Taken once per batch, so every message of a
+    // batch is charged the whole batch.
+    AtomicHistogram service_ns;
+};
+
+static inline void add(atomic<uint64_t> &counter, uint64_t n) {
+    counter.store(counter.load(memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+static inline void bump(atomic<uint64_t> &counter) {
+    add(counter, 1);
+}
+
+// Charge the time since `start_ns` to the `n` messages answered since.
+static void record_service(WorkerStats &stats, uint64_t start_ns, uint64_t n) {
+    if (n)
+        stats.service_ns.record(clock_ns(CLOCK_MONOTONIC) - start_ns, n);
+}
+
+// Messages answered by the worker so far, for record_service.
+static inline uint64_t answered(const WorkerStats &stats) {
+    return stats.messages.load(memory_order_relaxed);
+}
+
+// -v: print every message received and every connection opened or closed.
+// Off by default, since writing to the terminal costs far more than
+// answering the message; the accepted/active metrics count connections.
+static bool log_messages = false;
 
-    // Creating socket file descriptor
-    if ((server_fd = socket(AF_INET, SOCK_STREAM, 2)) == 0) {
+enum Backend { BACKEND_EPOLL, BACKEND_URING, BACKEND_UDP };
+
+struct EventLoop {
+    int epoll_fd = -1;
+    int listen_fd;      // the worker's datagram socket with BACKEND_UDP
+    Uring ring;
+    unordered_map<int, Connection> connections;
+    BufferPool pool;
+    WorkerStats stats;
+};
+
+// Replies never change, so their frames are encoded once at startup.
+static string reply_ok, reply_goodbye;
+
+// Charge the heap allocations made since `before` to the message path.
+static void count_allocations(EventLoop &loop, uint64_t before) {
+    if (heap_allocations != before)
+        add(loop.stats.message_allocations, heap_allocations - before);
+}
+
+// Thousands of connections need thousands of descriptors; lift the soft
+// limit up to whatever the hard limit allows.
+static void raise_fd_limit() {
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+}
+
+static int create_listener(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
         cerr << "Socket creation failed\n";
         return -1;
     }
 
+    // Every worker binds its own listener to the same port; with
+    // SO_REUSEPORT the kernel spreads incoming connections across them.
+    int opt = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt));
+    apply_socket_buffers(fd, socket_buffers);
+
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
     address.sin_family = AF_INET;
     address.sin_addr.s_addr = INADDR_ANY;
-    address.sin_port = htons(PORT);
+    address.sin_port = htons(port);
 
     // Bind the socket to the network address and port
-    if (bind(server_fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
+    if (bind(fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
         cerr << "Bind failed\n";
+        close(fd);
         return -1;
     }
 
     // Listen for incoming connections
-    if (listen(server_fd, 3) < 0) {
+    if (listen(fd, SOMAXCONN) < 0) {
         cerr << "Listen failed\n";
+        close(fd);
         return -1;
     }
+    return fd;
+}
 
-    cout << "Server started on port " << PORT << ". Waiting for connections...\n";
+// UDP backend: one datagram socket per worker, spread by SO_REUSEPORT
+// like the TCP listeners. `gro` lets the kernel coalesce incoming
+// datagrams (UDP_GRO).
+static int create_udp_socket(int port, bool gro) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        cerr << "Socket creation failed\n";
+        return -1;
+    }
+    int opt = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt));
+    if (gro && setsockopt(fd, SOL_UDP, UDP_GRO, &opt, sizeof(opt)) < 0) {
+        cerr << "UDP_GRO not supported: " << strerror(errno) << "\n";
+        close(fd);
+        return -1;
+    }
 
-    int addrlen = sizeof(address);
-    if ((new_socket = accept(server_fd, (struct sockaddr *)&address, (socklen_t *)&addrlen)) < 0) {
-        cerr << "Accept failed\n";
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = INADDR_ANY;
+    address.sin_port = htons(port);
+    if (bind(fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
+        cerr << "Bind failed\n";
+        close(fd);
         return -1;
     }
+    return fd;
+}
+
+static void close_connection(EventLoop &loop, int fd) {
+    auto it = loop.connections.find(fd);
+    if (it != loop.connections.end()) {
+        it->second.in.release(loop.pool);
+        it->second.out.release(loop.pool);
+        it->second.sending.release(loop.pool);
+    }
+    if (loop.epoll_fd >= 0) {
+        epoll_ctl(loop.epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+        bump(loop.stats.syscalls);
+    }
+    close(fd);
+    bump(loop.stats.syscalls);
+    if (it != loop.connections.end())
+        loop.connections.erase(it);
+    bump(loop.stats.closed);
+}
 
-    cout << "Client connected\n";
+// Write as much of the pending output as the socket accepts.
+// Returns false if the connection is broken.
+static bool send_pending(EventLoop &loop, Connection &conn) {
+    size_t sent = 0;
+    while (sent < conn.out.size()) {
+        ssize_t n = send(conn.fd, conn.out.data() + sent, conn.out.size() - sent, MSG_NOSIGNAL);
+        bump(loop.stats.syscalls);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            return false;
+        }
+        sent += n;
+    }
+    add(loop.stats.bytes_out, sent);
+    conn.out.consume(loop.pool, sent);
+    return true;
+}
 
+// Push raw bulk bytes until the socket is full or the transfer is done.
+// Returns 1 when finished, 0 when the socket would block, -1 on error.
+static int stream_bulk(EventLoop &loop, Connection &conn) {
+    while (conn.bulk_sent < conn.bulk_total) {
+        uint64_t left = conn.bulk_total - conn.bulk_sent;
+        uint64_t offset = bulk.from_file ? conn.bulk_sent : conn.bulk_sent % bulk.size;
+        size_t len = (size_t)min<uint64_t>(left, bulk.size - offset);
+        ssize_t n;
+        if (bulk.mode == BULK_SENDFILE) {
+            off_t off = (off_t)offset;
+            n = sendfile(conn.fd, bulk.fd, &off, len);
+        } else if (bulk.mode == BULK_ZEROCOPY) {
+            n = send(conn.fd, bulk.chunk + offset, len, MSG_NOSIGNAL | MSG_ZEROCOPY);
+            if (n >= 0)
+                conn.zc_sends++;
+        } else {
+            n = send(conn.fd, bulk.chunk + offset, len, MSG_NOSIGNAL);
+        }
+        bump(loop.stats.syscalls);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            // ENOBUFS: too many zerocopy sends outstanding; the next
+            // completion notification (EPOLLERR) resumes the stream.
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)
+                return 0;
+            return -1;
+        }
+        conn.bulk_sent += n;
+    }
+
+    double seconds = (clock_ns(CLOCK_MONOTONIC) - conn.bulk_start_ns) / 1e9;
+    double cpu = (clock_ns(CLOCK_THREAD_CPUTIME_ID) - conn.bulk_cpu_start_ns) / 1e9;
+    double gb = conn.bulk_total / 1e9;
+    add(loop.stats.bulk_bytes, conn.bulk_total);
+    cout << "Bulk transfer of " << conn.bulk_total << " bytes via " << bulk_mode_name(bulk.mode)
+         << " in " << seconds << " s: " << gb / seconds * 1e3 << " MB/s, "
+         << (gb > 0 ? cpu / gb : 0) << " CPU s/GB";
+    if (bulk.mode == BULK_ZEROCOPY)
+        cout << ", " << conn.zc_completed << "/" << conn.zc_sends << " sends completed, "
+             << conn.zc_copied << " fell back to copying";
+    cout << "\n";
+    conn.bulk_total = conn.bulk_sent = 0;
+    return 1;
+}
+
+// Drain MSG_ZEROCOPY completion notifications from the socket's error
+// queue. Returns false if the socket has a real error pending.
+static bool reap_zerocopy(EventLoop &loop, Connection &conn) {
     while (true) {
-        memset(buffer, 0, BUFFER_SIZE);
-        int valread = read(new_socket, buffer, BUFFER_SIZE);
+        char control[128];
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        bump(loop.stats.syscalls);
+        if (recvmsg(conn.fd, &msg, MSG_ERRQUEUE) < 0)
+            break;
+        for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+            struct sock_extended_err *err = (struct sock_extended_err *)CMSG_DATA(cm);
+            if (err->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+                continue;
+            // Each notification acknowledges the send range [ee_info, ee_data].
+            uint64_t count = (uint64_t)(err->ee_data - err->ee_info) + 1;
+            conn.zc_completed += count;
+            if (err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+                conn.zc_copied += count;
+        }
+    }
+    int error = 0;
+    socklen_t len = sizeof(error);
+    getsockopt(conn.fd, SOL_SOCKET, SO_ERROR, &error, &len);
+    return error == 0;
+}
+
+static long handle_frames(EventLoop &loop, Connection &conn, const char *buf, size_t len);
+
+// Send queued replies, then any bulk stream, then answer the requests that
+// were waiting behind the stream. Returns false if the connection is broken.
+static bool flush_output(EventLoop &loop, Connection &conn) {
+    while (true) {
+        if (!send_pending(loop, conn))
+            return false;
+        if (!conn.out.empty() || conn.bulk_total == 0)
+            return true;
+        int done = stream_bulk(loop, conn);
+        if (done <= 0)
+            return done == 0;
+        long used = handle_frames(loop, conn, conn.in.data(), conn.in.size());
+        if (used < 0)
+            return false;
+        conn.in.consume(loop.pool, used);
+    }
+}
+
+static void accept_connections(EventLoop &loop) {
+    while (true) {
+        int fd = accept4(loop.listen_fd, nullptr, nullptr, SOCK_NONBLOCK);
+        bump(loop.stats.syscalls);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                cerr << "Accept failed: " << strerror(errno) << "\n";
+            return;
+        }
+
+        struct epoll_event ev;
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        ev.data.fd = fd;
+        bump(loop.stats.syscalls);
+        if (epoll_ctl(loop.epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            close(fd);
+            continue;
+        }
+        loop.connections[fd] = Connection{fd};
+        bump(loop.stats.accepted);
+        if (log_messages)
+            cout << "Client connected\n";
+    }
+}
+
+// Queue the OP_BULK_START header and arm the raw stream that follows it.
+static bool start_bulk(EventLoop &loop, Connection &conn, const Frame &frame) {
+    if (loop.epoll_fd < 0) {
+        cerr << "Bulk transfers need the epoll backend\n";
+        return false;
+    }
+    uint64_t requested;
+    if (decode_varint(frame.payload, frame.length, requested) <= 0)
+        return false;
+
+    uint64_t total = requested ? requested : (bulk.from_file ? bulk.size : BULK_DEFAULT_SIZE);
+    if (bulk.from_file && total > bulk.size)
+        total = bulk.size;
+    if (bulk.mode == BULK_ZEROCOPY && conn.zc_sends == 0) {
+        int one = 1;
+        setsockopt(conn.fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one));
+    }
+
+    char count[MAX_VARINT_BYTES], header[MAX_FRAME_HEADER];
+    size_t count_len = encode_varint(total, count);
+    conn.out.append(loop.pool, header, encode_frame_header(header, OP_BULK_START, count_len));
+    conn.out.append(loop.pool, count, count_len);
+    conn.bulk_total = total;
+    conn.bulk_sent = 0;
+    conn.bulk_start_ns = clock_ns(CLOCK_MONOTONIC);
+    conn.bulk_cpu_start_ns = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+    return true;
+}
+
+// Answer one request frame. Returns false on a protocol violation.
+static bool handle_frame(EventLoop &loop, Connection &conn, const Frame &frame) {
+    if (frame.opcode == OP_BULK_REQUEST)
+        return start_bulk(loop, conn, frame);
+    if (frame.opcode != OP_MESSAGE)
+        return false;
 
-        if (valread <= 0) {
-            cout << "Connection closed by client\n";
+    bump(loop.stats.messages);
+    bump(loop.stats.replies);
+    string_view message(frame.payload, frame.length);
+    if (log_messages)
+        cout << "Received from client: " << message << "\n";
+
+    if (message == "Quit") {
+        conn.out.append(loop.pool, reply_goodbye.data(), reply_goodbye.size());
+        conn.closing = true;
+    } else {
+        conn.out.append(loop.pool, reply_ok.data(), reply_ok.size());
+    }
+    return true;
+}
+
+// Parse every complete frame in buf[0, len) and queue the replies in
+// order. Returns the number of bytes consumed, or -1 on a bad stream.
+static long handle_frames(EventLoop &loop, Connection &conn, const char *buf, size_t len) {
+    size_t used = 0;
+    while (!conn.closing && conn.bulk_total == 0) {
+        Frame frame;
+        long n = parse_frame(buf + used, len - used, frame);
+        if (n == 0)
             break;
+        if (n < 0 || !handle_frame(loop, conn, frame))
+            return -1;
+        used += n;
+    }
+    return used;
+}
+
+// Feed freshly received bytes to the frame parser. Parses straight out of
+// `buf` when no partial frame is pending; only leftovers are copied into
+// conn.in. Returns false on a bad stream.
+static bool consume_input(EventLoop &loop, Connection &conn, const char *buf, size_t len) {
+    long used;
+    if (conn.in.empty()) {
+        used = handle_frames(loop, conn, buf, len);
+        if (used < 0)
+            return false;
+        conn.in.append(loop.pool, buf + used, len - used);
+    } else {
+        conn.in.append(loop.pool, buf, len);
+        used = handle_frames(loop, conn, conn.in.data(), conn.in.size());
+        if (used < 0)
+            return false;
+        conn.in.consume(loop.pool, used);
+    }
+    return true;
+}
+
+// Whether to leave the socket's input unread for now. While a bulk stream
+// is being sent nothing is parsed, so reading on would only pile the
+// client's bytes up in conn.in. Replies past OUTPUT_HIGH_WATER mean the
+// client pipelines faster than it reads them; reading on would pile the
+// replies up in conn.out.
+static inline bool input_paused(const Connection &conn) {
+    return conn.bulk_total != 0 || conn.out.size() >= OUTPUT_HIGH_WATER;
+}
+
+// Drain the socket (edge-triggered: read until EAGAIN), answer every
+// complete frame and send all replies with one batched write. Stops early
+// while input_paused and the output cannot be flushed; no new edge comes
+// for the bytes left in the socket, so run() calls this again once
+// flush_output has lifted the pause.
+// Returns false once the connection should be closed.
+static bool handle_input(EventLoop &loop, Connection &conn) {
+    char buffer[BUFFER_SIZE];
+    uint64_t allocations = heap_allocations;
+    uint64_t start_ns = clock_ns(CLOCK_MONOTONIC), before = answered(loop.stats);
+
+    bool ok = true;
+    conn.read_paused = false;
+    while (ok && !conn.closing) {
+        if (input_paused(conn)) {
+            // Sending may lift the pause at once; if not, EPOLLOUT will
+            ok = flush_output(loop, conn);
+            conn.read_paused = ok && input_paused(conn);
+            if (conn.read_paused)
+                break;
+            continue;
+        }
+        ssize_t valread = read(conn.fd, buffer, BUFFER_SIZE);
+        bump(loop.stats.syscalls);
+        if (valread < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            return false;
+        }
+        if (valread == 0) {
+            if (log_messages)
+                cout << "Connection closed by client\n";
+            return false;
+        }
+        add(loop.stats.bytes_in, valread);
+        if (!consume_input(loop, conn, buffer, valread))
+            return false;
+    }
+
+    if (ok && !conn.read_paused)
+        ok = flush_output(loop, conn);
+    record_service(loop.stats, start_ns, answered(loop.stats) - before);
+    count_allocations(loop, allocations);
+    return ok && !(conn.closing && conn.out.empty());
+}
+
+static void run(EventLoop &loop) {
+    struct epoll_event events[MAX_EVENTS];
+
+    while (true) {
+        int n = epoll_wait(loop.epoll_fd, events, MAX_EVENTS, -1);
+        bump(loop.stats.syscalls);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            cerr << "epoll_wait failed\n";
+            return;
+        }
+
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+            if (fd == loop.listen_fd) {
+                accept_connections(loop);
+                continue;
+            }
+
+            auto it = loop.connections.find(fd);
+            if (it == loop.connections.end())
+                continue;
+            Connection &conn = it->second;
+
+            // Zerocopy completions are delivered as EPOLLERR; only a real
+            // socket error closes the connection.
+            bool keep = !(events[i].events & EPOLLERR) || reap_zerocopy(loop, conn);
+            if (keep && (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)))
+                keep = handle_input(loop, conn);
+            if (keep && (events[i].events & (EPOLLOUT | EPOLLERR))) {
+                keep = flush_output(loop, conn);
+                if (keep && conn.closing && conn.out.empty())
+                    keep = false;
+                if (keep && conn.read_paused && !input_paused(conn))
+                    keep = handle_input(loop, conn);
+            }
+            if (!keep)
+                close_connection(loop, fd);
+        }
+    }
+}
+
+static inline uint64_t uring_tag(int fd, int op) {
+    return (uint64_t)fd << 8 | op;
+}
+
+static void uring_arm_recv(EventLoop &loop, Connection &conn) {
+    uring_prep_multishot_recv(uring_get_sqe(loop.ring), conn.fd, 0, uring_tag(conn.fd, OP_RECV_DONE));
+    conn.recv_armed = true;
+}
+
+// Hand everything queued in conn.out to the kernel as one send, unless a
+// send is already in flight (its completion will pick up the rest).
+static void uring_send(EventLoop &loop, Connection &conn) {
+    if (conn.send_inflight || conn.out.empty())
+        return;
+    swap(conn.sending, conn.out);
+    uring_prep_send(uring_get_sqe(loop.ring), conn.fd, conn.sending.data(), conn.sending.size(),
+                    uring_tag(conn.fd, OP_SEND_DONE));
+    conn.send_inflight = true;
+}
+
+// Stop receiving: shutting the socket down completes the multishot recv
+// with 0, and the connection is freed once no operation references it.
+static void uring_finish(EventLoop &loop, Connection &conn) {
+    shutdown(conn.fd, SHUT_RDWR);
+    bump(loop.stats.syscalls);
+    if (!conn.recv_armed && !conn.send_inflight)
+        close_connection(loop, conn.fd);
+}
+
+static void uring_handle_cqe(EventLoop &loop, struct io_uring_cqe *cqe) {
+    int fd = (int)(cqe->user_data >> 8);
+    int op = (int)(cqe->user_data & 0xff);
+    bool more = cqe->flags & IORING_CQE_F_MORE;
+
+    if (op == OP_ACCEPT_DONE) {
+        if (cqe->res >= 0) {
+            Connection &conn = loop.connections[cqe->res];
+            conn = Connection{cqe->res};
+            bump(loop.stats.accepted);
+            if (log_messages)
+                cout << "Client connected\n";
+            uring_arm_recv(loop, conn);
+        }
+        if (!more)
+            uring_prep_multishot_accept(uring_get_sqe(loop.ring), loop.listen_fd,
+                                        uring_tag(loop.listen_fd, OP_ACCEPT_DONE));
+        return;
+    }
+
+    auto it = loop.connections.find(fd);
+    if (it == loop.connections.end())
+        return;
+    Connection &conn = it->second;
+
+    if (op == OP_RECV_DONE) {
+        if (!more)
+            conn.recv_armed = false;
+        if (cqe->res > 0) {
+            uint16_t bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+            uint64_t allocations = heap_allocations;
+            uint64_t start_ns = clock_ns(CLOCK_MONOTONIC), before = answered(loop.stats);
+            add(loop.stats.bytes_in, cqe->res);
+            bool ok = conn.closing || consume_input(loop, conn, uring_buf(loop.ring, bid), cqe->res);
+            uring_buf_push(loop.ring, bid);
+            if (!ok) {
+                uring_finish(loop, conn);
+                return;
+            }
+            uring_send(loop, conn);
+            record_service(loop.stats, start_ns, answered(loop.stats) - before);
+            count_allocations(loop, allocations);
+            if (!more && !conn.closing)
+                uring_arm_recv(loop, conn);
+        } else if (cqe->res == -ENOBUFS && !conn.closing) {
+            // Ran out of provided buffers; they are recycled as soon as
+            // each completion is handled, so simply re-arm.
+            uring_arm_recv(loop, conn);
+        } else {
+            if (cqe->res == 0 && !conn.closing && log_messages)
+                cout << "Connection closed by client\n";
+            conn.closing = true;
+            if (!conn.send_inflight)
+                close_connection(loop, fd);
         }
+        return;
+    }
+
+    // OP_SEND_DONE
+    conn.send_inflight = false;
+    if (cqe->res < 0) {
+        uring_finish(loop, conn);
+        return;
+    }
+    add(loop.stats.bytes_out, cqe->res);
+    conn.sending.consume(loop.pool, cqe->res);
+    if (!conn.sending.empty()) {
+        // Short send: the unsent tail goes out before any newer output.
+        uring_prep_send(uring_get_sqe(loop.ring), conn.fd, conn.sending.data(), conn.sending.size(),
+                        uring_tag(conn.fd, OP_SEND_DONE));
+        conn.send_inflight = true;
+        return;
+    }
+    if (!conn.out.empty())
+        uring_send(loop, conn);
+    else if (conn.closing)
+        uring_finish(loop, conn);
+}
 
-        cout << "Received from client: " << buffer << "\n";
+// io_uring backend: one multishot accept feeds multishot recvs that draw
+// from the provided buffer ring; every SQE produced while handling a
+// batch of completions goes to the kernel with a single io_uring_enter.
+static void run_uring(EventLoop &loop) {
+    int err = uring_init(loop.ring, URING_ENTRIES);
+    if (err == 0)
+        err = uring_setup_buffers(loop.ring, 0, URING_BUF_COUNT, URING_BUF_SIZE);
+    if (err < 0) {
+        cerr << "io_uring setup failed: " << strerror(-err) << "\n";
+        exit(1);
+    }
 
-        string reply;
-        if (string(buffer) == "Quit") {
-            reply = "Goodbye";
-            send(new_socket, reply.c_str(), reply.size(), 0);
+    uring_prep_multishot_accept(uring_get_sqe(loop.ring), loop.listen_fd,
+                                uring_tag(loop.listen_fd, OP_ACCEPT_DONE));
+    while (true) {
+        if (uring_submit(loop.ring, 1) < 0) {
+            cerr << "io_uring_enter failed: " << strerror(errno) << "\n";
+            return;
+        }
+        bump(loop.stats.syscalls);
+        uring_for_each_cqe(loop.ring, [&loop](struct io_uring_cqe *cqe) {
+            uring_handle_cqe(loop, cqe);
+        });
+        uring_buf_commit(loop.ring);
+    }
+}
+
+// Answer one request datagram by queueing its reply in `out`. Anything
+// that is not a single well-formed OP_DGRAM_MESSAGE frame is dropped.
+static void udp_answer(EventLoop &loop, UdpSendBatch &out, const struct sockaddr_in &peer,
+                       const char *buf, size_t len) {
+    Frame frame;
+    long n = parse_frame(buf, len, frame);
+    if (n <= 0 || (size_t)n != len || frame.opcode != OP_DGRAM_MESSAGE ||
+        frame.length < DGRAM_SEQ_BYTES)
+        return;
+
+    bump(loop.stats.messages);
+    string_view message(frame.payload + DGRAM_SEQ_BYTES, frame.length - DGRAM_SEQ_BYTES);
+    if (log_messages)
+        cout << "Received from client: " << message << "\n";
+
+    string_view text = message == "Quit" ? "Goodbye" : "OK";
+    char header[MAX_FRAME_HEADER];
+    size_t header_len = encode_frame_header(header, OP_DGRAM_REPLY, DGRAM_SEQ_BYTES + text.size());
+    size_t reply_len = header_len + DGRAM_SEQ_BYTES + text.size();
+    char *reply = udp_send_slot(out, &peer, reply_len);
+    if (!reply) {
+        add(loop.stats.syscalls, udp_send_flush(loop.listen_fd, out));
+        reply = udp_send_slot(out, &peer, reply_len);
+    }
+    memcpy(reply, header, header_len);
+    memcpy(reply + header_len, frame.payload, DGRAM_SEQ_BYTES);
+    memcpy(reply + header_len + DGRAM_SEQ_BYTES, text.data(), text.size());
+    bump(loop.stats.replies);
+    add(loop.stats.bytes_out, reply_len);
+}
+
+// UDP backend: a blocking recvmmsg returns as soon as one datagram is
+// there, with up to UDP_BATCH of them, and all replies go back with one
+// sendmmsg. With `offload` incoming datagrams may arrive GRO-coalesced
+// and replies to the same peer are merged into GSO sends.
+static void run_udp(EventLoop &loop, bool offload) {
+    UdpRecvBatch in;
+    UdpSendBatch out;
+    udp_recv_init(in, offload ? UDP_GRO_SLOT : UDP_MAX_DATAGRAM);
+    udp_send_init(out, offload);
+
+    while (true) {
+        int n = udp_recv(loop.listen_fd, in, MSG_WAITFORONE);
+        bump(loop.stats.syscalls);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            cerr << "recvmmsg failed: " << strerror(errno) << "\n";
+            return;
+        }
+
+        uint64_t allocations = heap_allocations;
+        uint64_t start_ns = clock_ns(CLOCK_MONOTONIC), before = answered(loop.stats);
+        for (int i = 0; i < n; i++)
+            udp_for_each_datagram(in, i, [&loop, &out, &in, i](const char *buf, size_t len) {
+                add(loop.stats.bytes_in, len);
+                udp_answer(loop, out, in.addrs[i], buf, len);
+            });
+        add(loop.stats.syscalls, udp_send_flush(loop.listen_fd, out));
+        record_service(loop.stats, start_ns, answered(loop.stats) - before);
+        count_allocations(loop, allocations);
+    }
+}
+
+// Shared-memory transport (-m): every client that connects to the Unix
+// socket gets its own ring pair (shmring.h) and its own thread, which
+// blocks in the ring instead of an event loop. All shm threads share one
+// set of counters, so they add atomically; `syscalls` counts their futex
+// calls, the only syscalls on their message path.
+static WorkerStats shm_stats;
+
+// Answer the frames in `in` like handle_frame does, counting them in
+// `count`. Returns the bytes consumed, or -1 on anything but OP_MESSAGE
+// (bulk transfers need TCP).
+static long shm_answer(const string &in, string &out, bool &closing, uint64_t &count) {
+    size_t used = 0;
+    while (!closing) {
+        Frame frame;
+        long n = parse_frame(in.data() + used, in.size() - used, frame);
+        if (n == 0)
             break;
+        if (n < 0 || frame.opcode != OP_MESSAGE)
+            return -1;
+        used += n;
+
+        count++;
+        string_view message(frame.payload, frame.length);
+        if (log_messages)
+            cout << "Received from client: " << message << "\n";
+        if (message == "Quit") {
+            out += reply_goodbye;
+            closing = true;
         } else {
-            reply = "OK";
+            out += reply_ok;
         }
+    }
+    return used;
+}
 
-        send(new_socket, reply.c_str(), reply.size(), 0);
+static void serve_shm(int sock, ShmChannel *channel) {
+    ShmSpin spin;
+    string in, out;
+    char buffer[BUFFER_SIZE];
+    bool closing = false;
+
+    while (!closing) {
+        long n = shm_ring_read(channel->requests, spin, buffer, BUFFER_SIZE, SHM_IDLE_CHECK_MS);
+        if (n == 0 && !shm_peer_gone(sock))
+            continue;
+        if (n <= 0)
+            break;
+        uint64_t start_ns = clock_ns(CLOCK_MONOTONIC), count = 0;
+        in.append(buffer, n);
+        long used = shm_answer(in, out, closing, count);
+        if (used < 0)
+            break;
+        in.erase(0, used);
+        shm_stats.bytes_in.fetch_add(n, memory_order_relaxed);
+        shm_stats.messages.fetch_add(count, memory_order_relaxed);
+        shm_stats.replies.fetch_add(count, memory_order_relaxed);
+
+        size_t sent = 0;
+        while (sent < out.size()) {
+            long w = shm_ring_write(channel->replies, spin, out.data() + sent, out.size() - sent,
+                                    SHM_IDLE_CHECK_MS);
+            if (w < 0 || (w == 0 && shm_peer_gone(sock)))
+                break;
+            sent += w;
+        }
+        shm_stats.bytes_out.fetch_add(sent, memory_order_relaxed);
+        if (sent < out.size())
+            break;
+        out.clear();
+        record_service(shm_stats, start_ns, count);
+    }
+
+    shm_ring_close(channel->requests);
+    shm_ring_close(channel->replies);
+    shm_unmap(channel);
+    close(sock);
+    shm_stats.syscalls.fetch_add(spin.syscalls, memory_order_relaxed);
+    shm_stats.closed.fetch_add(1, memory_order_relaxed);
+    if (log_messages)
+        cout << "Connection closed by client\n";
+}
+
+static void run_shm(int listen_fd) {
+    while (true) {
+        int sock = accept(listen_fd, nullptr, nullptr);
+        if (sock < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            cerr << "Accept failed: " << strerror(errno) << "\n";
+            return;
+        }
+        ShmChannel *channel = shm_accept(sock);
+        if (!channel) {
+            cerr << "Cannot set up shared memory: " << strerror(errno) << "\n";
+            close(sock);
+            continue;
+        }
+        shm_stats.accepted.fetch_add(1, memory_order_relaxed);
+        if (log_messages)
+            cout << "Client connected\n";
+        thread(serve_shm, sock, channel).detach();
     }
+}
 
-    close(new_socket);
-    close(server_fd);
+// Pin the calling thread to the index-th CPU this process may run on.
+static void pin_to_core(int index) {
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+        return;
+    int count = CPU_COUNT(&allowed);
+    if (count == 0)
+        return;
+    int target = index % count;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, &allowed))
+            continue;
+        if (target-- == 0) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpu, &set);
+            pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+            return;
+        }
+    }
+}
+
+static bool setup_loop(EventLoop &loop, int port, Backend backend, bool udp_offload) {
+    if (backend == BACKEND_UDP) {
+        loop.listen_fd = create_udp_socket(port, udp_offload);
+        return loop.listen_fd >= 0;
+    }
+    loop.listen_fd = create_listener(port);
+    if (loop.listen_fd < 0)
+        return false;
+    if (backend == BACKEND_URING)
+        return true;    // the ring is created by the worker thread itself
+
+    loop.epoll_fd = epoll_create1(0);
+    if (loop.epoll_fd < 0) {
+        cerr << "epoll_create1 failed\n";
+        return false;
+    }
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.fd = loop.listen_fd;
+    epoll_ctl(loop.epoll_fd, EPOLL_CTL_ADD, loop.listen_fd, &ev);
+    return true;
+}
+
+static void print_stats(const vector<EventLoop> &loops) {
+    uint64_t accepted = 0, closed = 0, messages = 0, syscalls = 0, bulk_bytes = 0, allocations = 0;
+    for (size_t i = 0; i < loops.size(); i++) {
+        const WorkerStats &st = loops[i].stats;
+        uint64_t a = st.accepted.load(memory_order_relaxed);
+        uint64_t c = st.closed.load(memory_order_relaxed);
+        uint64_t m = st.messages.load(memory_order_relaxed);
+        uint64_t sc = st.syscalls.load(memory_order_relaxed);
+        cerr << "worker " << i << ": accepted " << a << ", active " << a - c
+             << ", messages " << m << ", syscalls " << sc << "\n";
+        accepted += a;
+        closed += c;
+        messages += m;
+        syscalls += sc;
+        bulk_bytes += st.bulk_bytes.load(memory_order_relaxed);
+        allocations += st.message_allocations.load(memory_order_relaxed);
+    }
+    cerr << "total: accepted " << accepted << ", active " << accepted - closed
+         << ", messages " << messages << ", syscalls " << syscalls;
+    if (messages)
+        cerr << ", syscalls/message " << (double)syscalls / messages;
+    if (bulk_bytes)
+        cerr << ", bulk bytes " << bulk_bytes;
+    cerr << ", message-path allocations " << allocations << "\n";
+}
+
+// Futex calls of connections still open are not included.
+static void print_shm_stats() {
+    uint64_t a = shm_stats.accepted.load(memory_order_relaxed);
+    uint64_t c = shm_stats.closed.load(memory_order_relaxed);
+    uint64_t m = shm_stats.messages.load(memory_order_relaxed);
+    uint64_t sc = shm_stats.syscalls.load(memory_order_relaxed);
+    cerr << "shm: accepted " << a << ", active " << a - c << ", messages " << m << ", futex syscalls " << sc;
+    if (m)
+        cerr << ", syscalls/message " << (double)sc / m;
+    cerr << "\n";
+}
+
+// Plain sums of one or more WorkerStats, read with relaxed loads.
+struct StatsSnapshot {
+    uint64_t accepted = 0, closed = 0, messages = 0, replies = 0;
+    uint64_t bytes_in = 0, bytes_out = 0, syscalls = 0;
+    Histogram service_ns;
+
+    void merge(const WorkerStats &st) {
+        accepted += st.accepted.load(memory_order_relaxed);
+        closed += st.closed.load(memory_order_relaxed);
+        messages += st.messages.load(memory_order_relaxed);
+        replies += st.replies.load(memory_order_relaxed);
+        bytes_in += st.bytes_in.load(memory_order_relaxed);
+        bytes_out += st.bytes_out.load(memory_order_relaxed);
+        syscalls += st.syscalls.load(memory_order_relaxed);
+        st.service_ns.snapshot(service_ns);
+    }
+
+    void merge(const StatsSnapshot &other) {
+        accepted += other.accepted;
+        closed += other.closed;
+        messages += other.messages;
+        replies += other.replies;
+        bytes_in += other.bytes_in;
+        bytes_out += other.bytes_out;
+        syscalls += other.syscalls;
+        service_ns.merge(other.service_ns);
+    }
+};
+
+// One line of the metrics text: `name` followed by key=value pairs.
+// Service times are in microseconds.
+static void append_metrics_line(string &text, const char *name, const StatsSnapshot &s) {
+    const Histogram &h = s.service_ns;
+    char line[640];
+    snprintf(line, sizeof(line),
+             "worker=%s accepted=%" PRIu64 " active=%" PRIu64 " messages_in=%" PRIu64
+             " messages_out=%" PRIu64 " bytes_in=%" PRIu64 " bytes_out=%" PRIu64 " syscalls=%" PRIu64
+             " service_count=%" PRIu64 " service_mean_us=%.2f service_p50_us=%.2f"
+             " service_p90_us=%.2f service_p99_us=%.2f service_p999_us=%.2f service_max_us=%.2f\n",
+             name, s.accepted, s.accepted - s.closed, s.messages, s.replies, s.bytes_in, s.bytes_out,
+             s.syscalls, h.total, h.mean() / 1e3, h.percentile(50) / 1e3, h.percentile(90) / 1e3,
+             h.percentile(99) / 1e3, h.percentile(99.9) / 1e3, h.max / 1e3);
+    text += line;
+}
+
+// Everything the metrics socket reports: one line per worker, one for
+// the shm transport when it is enabled, and their total.
+static string format_metrics(const vector<EventLoop> &loops, bool with_shm) {
+    string text;
+    StatsSnapshot total;
+    for (size_t i = 0; i < loops.size(); i++) {
+        StatsSnapshot worker;
+        worker.merge(loops[i].stats);
+        append_metrics_line(text, to_string(i).c_str(), worker);
+        total.merge(worker);
+    }
+    if (with_shm) {
+        StatsSnapshot shm;
+        shm.merge(shm_stats);
+        append_metrics_line(text, "shm", shm);
+        total.merge(shm);
+    }
+    append_metrics_line(text, "total", total);
+    return text;
+}
+
+// Metrics socket (-s): every client that connects is sent one snapshot
+// and disconnected. Only this thread does any work for it; the workers'
+// counters are read with relaxed loads and never locked.
+static void run_metrics(int listen_fd, const vector<EventLoop> *loops, bool with_shm) {
+    while (true) {
+        int sock = accept(listen_fd, nullptr, nullptr);
+        if (sock < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            cerr << "Accept failed: " << strerror(errno) << "\n";
+            return;
+        }
+        string text = format_metrics(*loops, with_shm);
+        size_t sent = 0;
+        while (sent < text.size()) {
+            ssize_t n = send(sock, text.data() + sent, text.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0)
+                break;
+            sent += n;
+        }
+        close(sock);
+    }
+}
+
+// Prepare the bulk data source: the file given with -f, or a generated
+// chunk that is cycled (kept in a memfd when it has to go through
+// sendfile).
+static bool setup_bulk(BulkMode mode, const char *path) {
+    bulk.mode = mode;
+    if (path) {
+        if (mode != BULK_SENDFILE) {
+            cerr << "-f needs -z sendfile\n";
+            return false;
+        }
+        bulk.fd = open(path, O_RDONLY);
+        struct stat st;
+        if (bulk.fd < 0 || fstat(bulk.fd, &st) < 0 || st.st_size == 0) {
+            cerr << "Cannot read " << path << "\n";
+            return false;
+        }
+        bulk.size = st.st_size;
+        bulk.from_file = true;
+        return true;
+    }
+
+    bulk.chunk = (char *)mmap(nullptr, BULK_CHUNK_SIZE, PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if (bulk.chunk == MAP_FAILED) {
+        cerr << "Cannot allocate bulk buffer\n";
+        return false;
+    }
+    for (size_t i = 0; i < BULK_CHUNK_SIZE; i++)
+        bulk.chunk[i] = (char)('a' + i % 26);
+
+    if (mode == BULK_SENDFILE) {
+        bulk.fd = memfd_create("bulk", 0);
+        if (bulk.fd < 0 || write(bulk.fd, bulk.chunk, BULK_CHUNK_SIZE) != BULK_CHUNK_SIZE) {
+            cerr << "Cannot create bulk memfd\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    int port = PORT;
+    int threads = 1;
+    Backend backend = BACKEND_EPOLL;
+    BulkMode bulk_mode = BULK_COPY;
+    const char *bulk_file = nullptr;
+    bool udp_offload = false;
+    const char *shm_path = nullptr;
+    const char *metrics_path = nullptr;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "p:t:b:z:f:w:ugm:s:v")) != -1) {
+        switch (opt) {
+        case 'p': port = atoi(optarg); break;
+        case 't': threads = atoi(optarg); break;
+        case 'b':
+            if (strcmp(optarg, "uring") == 0)
+                backend = BACKEND_URING;
+            else if (strcmp(optarg, "epoll") == 0)
+                backend = BACKEND_EPOLL;
+            else {
+                cerr << "Unknown backend " << optarg << " (expected epoll or uring)\n";
+                return 1;
+            }
+            break;
+        case 'z':
+            if (strcmp(optarg, "copy") == 0)
+                bulk_mode = BULK_COPY;
+            else if (strcmp(optarg, "sendfile") == 0)
+                bulk_mode = BULK_SENDFILE;
+            else if (strcmp(optarg, "zerocopy") == 0)
+                bulk_mode = BULK_ZEROCOPY;
+            else {
+                cerr << "Unknown bulk mode " << optarg << " (expected copy, sendfile or zerocopy)\n";
+                return 1;
+            }
+            break;
+        case 'f': bulk_file = optarg; break;
+        case 'w':
+            if (!parse_socket_buffer(optarg, socket_buffers)) {
+                cerr << "Bad socket buffer " << optarg << " (expected BYTES or MBPS:RTT_MS)\n";
+                return 1;
+            }
+            break;
+        case 'u': backend = BACKEND_UDP; break;
+        case 'g': udp_offload = true; break;
+        case 'm': shm_path = optarg; break;
+        case 's': metrics_path = optarg; break;
+        case 'v': log_messages = true; break;
+        default:
+            cerr << "Usage: " << argv[0] << " [-p port] [-t threads] [-b epoll|uring]"
+                 << " [-z copy|sendfile|zerocopy] [-f file] [-w bytes|mbps:rtt_ms]\n"
+                 << "       " << argv[0] << " -u [-g] [-p port] [-t threads]\n"
+                 << "       -m path also serves same-host clients over shared memory, set up\n"
+                 << "       through a Unix socket at path\n"
+                 << "       -s path publishes live counters on a Unix socket at path\n"
+                 << "       -v prints every message received\n";
+            return 1;
+        }
+    }
+    if (threads < 1)
+        threads = 1;
+
+    signal(SIGPIPE, SIG_IGN);
+    raise_fd_limit();
+    if (!setup_bulk(bulk_mode, bulk_file))
+        return 1;
+    append_frame(reply_ok, OP_REPLY, "OK", 2);
+    append_frame(reply_goodbye, OP_REPLY, "Goodbye", 7);
+
+    // Workers inherit this mask, so SIGINT/SIGTERM are only seen by the
+    // main thread's sigwait below.
+    sigset_t stop_signals;
+    sigemptyset(&stop_signals);
+    sigaddset(&stop_signals, SIGINT);
+    sigaddset(&stop_signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop_signals, nullptr);
+
+    vector<EventLoop> loops(threads);
+    for (EventLoop &loop : loops)
+        if (!setup_loop(loop, port, backend, udp_offload))
+            return -1;
+
+    const char *backend_name = backend == BACKEND_URING ? "io_uring"
+                             : backend == BACKEND_UDP ? (udp_offload ? "UDP (GSO/GRO)" : "UDP")
+                             : "epoll";
+    cout << "Server started on port " << port << " with " << threads << " " << backend_name
+         << " worker(s). Waiting for connections...\n";
+    if (socket_buffers.bytes > 0 && backend != BACKEND_UDP)
+        print_socket_buffers(loops[0].listen_fd, socket_buffers);
+
+    if (shm_path) {
+        int shm_fd = unix_listen(shm_path);
+        if (shm_fd < 0) {
+            cerr << "Cannot listen on " << shm_path << ": " << strerror(errno) << "\n";
+            return -1;
+        }
+        cout << "Shared-memory clients connect through " << shm_path << "\n";
+        thread(run_shm, shm_fd).detach();
+    }
+    if (metrics_path) {
+        int metrics_fd = unix_listen(metrics_path);
+        if (metrics_fd < 0) {
+            cerr << "Cannot listen on " << metrics_path << ": " << strerror(errno) << "\n";
+            return -1;
+        }
+        cout << "Metrics are served on " << metrics_path << "\n";
+        thread(run_metrics, metrics_fd, &loops, shm_path != nullptr).detach();
+    }
+
+    vector<thread> workers;
+    for (int i = 0; i < threads; i++) {
+        workers.emplace_back([&loops, i, backend, udp_offload] {
+            pin_to_core(i);
+            if (backend == BACKEND_URING)
+                run_uring(loops[i]);
+            else if (backend == BACKEND_UDP)
+                run_udp(loops[i], udp_offload);
+            else
+                run(loops[i]);
+        });
+        workers.back().detach();
+    }
+
+    int sig;
+    sigwait(&stop_signals, &sig);
+    cout << flush;
+    print_stats(loops);
+    if (shm_path) {
+        print_shm_stats();
+        unlink(shm_path);
+    }
+    if (metrics_path)
+        unlink(metrics_path);
     return 0;
 }
@@ -0,0 +1,270 @@
+// Shared-memory transport for clients on the same host (server -m,
+// client -m). The request/reply byte stream is exactly what TCP would
+// carry, but it moves through two single-producer/single-consumer rings
+// in one shared segment, requests in one and replies in the other, so a
+// message costs two memcpys and no syscall while both sides are busy.
+//
+// Setup goes through a Unix socket (unixsock.h): the server creates the segment as a
+// memfd for every client that connects and passes the descriptor over
+// with SCM_RIGHTS. The socket stays open for the life of the connection,
+// so each side can notice when the other one has exited.
+//
+// An empty (or full) ring is first polled, and the waiting side only
+// sleeps on a futex after `limit` polls; the other side makes the
+// FUTEX_WAKE syscall only while somebody sleeps. The poll limit adapts
+// per side: a sleep that ended within SHM_SPIN_WORTH_NS means polling a
+// little longer would have avoided two syscalls and a context switch, so
+// the limit doubles; a longer sleep halves it, so an idle connection
+// costs almost no CPU. A process that may only use one CPU never polls:
+// the other side cannot make progress until the waiter gives the CPU up.
+#ifndef SHMRING_H
+#define SHMRING_H
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <linux/futex.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "unixsock.h"
+
+#define SHM_RING_SIZE (1 << 20)         // bytes per direction, a power of two
+#define SHM_SPIN_MIN 64                 // polls before sleeping, adapted in this range
+#define SHM_SPIN_MAX (1 << 18)
+#define SHM_SPIN_WORTH_NS 50000         // sleeps shorter than this raise the poll limit
+#define SHM_IDLE_CHECK_MS 100           // sleepers wake this often to check on their peer
+
+// One direction. The segment is a fresh memfd, so everything starts at 0.
+struct ShmRing {
+    alignas(64) std::atomic<uint64_t> head;     // bytes written, advanced by the producer
+    alignas(64) std::atomic<uint64_t> tail;     // bytes read, advanced by the consumer
+    // Futex words, bumped before a FUTEX_WAKE. A side raises its *_waiting
+    // flag before it sleeps and the other side checks the flag after
+    // publishing, so a wakeup cannot be lost.
+    alignas(64) std::atomic<uint32_t> data_seq;
+    std::atomic<uint32_t> data_waiting;
+    alignas(64) std::atomic<uint32_t> space_seq;
+    std::atomic<uint32_t> space_waiting;
+    std::atomic<uint32_t> closed;
+    alignas(64) char data[SHM_RING_SIZE];
+};
+
+struct ShmChannel {
+    ShmRing requests;   // client -> server
+    ShmRing replies;    // server -> client
+};
+
+// Upper bound of the poll limit: SHM_SPIN_MAX, or 0 on a single CPU.
+inline uint32_t shm_spin_max() {
+    static const uint32_t max = [] {
+        cpu_set_t allowed;
+        bool multi = sched_getaffinity(0, sizeof(allowed), &allowed) != 0 || CPU_COUNT(&allowed) > 1;
+        return multi ? (uint32_t)SHM_SPIN_MAX : 0;
+    }();
+    return max;
+}
+
+// Per-side wait state; lives in the process, not in the segment.
+struct ShmSpin {
+    uint32_t limit = shm_spin_max() ? SHM_SPIN_MIN : 0;
+    uint64_t syscalls = 0;      // FUTEX_WAIT and FUTEX_WAKE calls
+};
+
+inline long shm_futex(std::atomic<uint32_t> &word, int op, uint32_t value,
+                      const struct timespec *timeout) {
+    return syscall(SYS_futex, (uint32_t *)&word, op, value, timeout, nullptr, 0);
+}
+
+inline void shm_cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+inline uint64_t shm_clock_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Wait until ready() holds: poll, then sleep on `seq` for at most
+// timeout_ms. Returns whether ready() holds.
+template <class Ready>
+inline bool shm_wait(ShmSpin &spin, std::atomic<uint32_t> &seq, std::atomic<uint32_t> &waiting,
+                     Ready ready, int timeout_ms) {
+    for (uint32_t i = 0; i < spin.limit; i++) {
+        if (ready())
+            return true;
+        shm_cpu_relax();
+    }
+
+    uint32_t value = seq.load();
+    waiting.store(1);
+    bool ok = ready();
+    if (!ok) {
+        struct timespec timeout = {timeout_ms / 1000, (long)(timeout_ms % 1000) * 1000000};
+        uint64_t start = shm_clock_ns();
+        shm_futex(seq, FUTEX_WAIT, value, &timeout);
+        spin.syscalls++;
+        ok = ready();
+        if (ok && shm_clock_ns() - start < SHM_SPIN_WORTH_NS) {
+            if (spin.limit < shm_spin_max())
+                spin.limit *= 2;
+        } else if (spin.limit > SHM_SPIN_MIN) {
+            spin.limit /= 2;
+        }
+    }
+    waiting.store(0);
+    return ok;
+}
+
+inline void shm_signal(ShmSpin &spin, std::atomic<uint32_t> &seq, std::atomic<uint32_t> &waiting) {
+    if (waiting.load()) {
+        seq.fetch_add(1);
+        shm_futex(seq, FUTEX_WAKE, 1, nullptr);
+        spin.syscalls++;
+    }
+}
+
+// Copy up to `max` bytes out of the ring, waiting up to timeout_ms for
+// some to arrive. Returns the bytes copied, 0 on timeout, or -1 once the
+// ring is closed and empty.
+inline long shm_ring_read(ShmRing &r, ShmSpin &spin, char *buf, size_t max, int timeout_ms) {
+    uint64_t tail = r.tail.load(std::memory_order_relaxed);
+    auto ready = [&r, tail] { return r.head.load() != tail || r.closed.load(); };
+    if (!shm_wait(spin, r.data_seq, r.data_waiting, ready, timeout_ms))
+        return 0;
+
+    uint64_t head = r.head.load();
+    if (head == tail)
+        return -1;
+    size_t n = head - tail < max ? head - tail : max;
+    size_t offset = tail & (SHM_RING_SIZE - 1);
+    size_t first = n < SHM_RING_SIZE - offset ? n : SHM_RING_SIZE - offset;
+    memcpy(buf, r.data + offset, first);
+    memcpy(buf + first, r.data, n - first);
+    r.tail.store(tail + n);
+    shm_signal(spin, r.space_seq, r.space_waiting);
+    return (long)n;
+}
+
+// Copy up to `len` bytes into the ring, waiting up to timeout_ms for
+// space. Returns the bytes copied, 0 on timeout, or -1 if the ring is
+// closed.
+inline long shm_ring_write(ShmRing &r, ShmSpin &spin, const char *buf, size_t len, int timeout_ms) {
+    uint64_t head = r.head.load(std::memory_order_relaxed);
+    auto ready = [&r, head] { return head - r.tail.load() < SHM_RING_SIZE || r.closed.load(); };
+    if (!shm_wait(spin, r.space_seq, r.space_waiting, ready, timeout_ms))
+        return 0;
+    if (r.closed.load())
+        return -1;
+
+    size_t space = SHM_RING_SIZE - (head - r.tail.load());
+    size_t n = len < space ? len : space;
+    size_t offset = head & (SHM_RING_SIZE - 1);
+    size_t first = n < SHM_RING_SIZE - offset ? n : SHM_RING_SIZE - offset;
+    memcpy(r.data + offset, buf, first);
+    memcpy(r.data, buf + first, n - first);
+    r.head.store(head + n);
+    shm_signal(spin, r.data_seq, r.data_waiting);
+    return (long)n;
+}
+
+// No more bytes will be written (or read); wakes a sleeper on either side.
+inline void shm_ring_close(ShmRing &r) {
+    r.closed.store(1);
+    r.data_seq.fetch_add(1);
+    shm_futex(r.data_seq, FUTEX_WAKE, 1, nullptr);
+    r.space_seq.fetch_add(1);
+    shm_futex(r.space_seq, FUTEX_WAKE, 1, nullptr);
+}
+
+// Whether the process at the other end of the setup socket has exited.
+inline bool shm_peer_gone(int sock) {
+    char byte;
+    ssize_t n = recv(sock, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+    return n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR);
+}
+
+inline ShmChannel *shm_map(int fd) {
+    void *p = mmap(nullptr, sizeof(ShmChannel), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+    return p == MAP_FAILED ? nullptr : (ShmChannel *)p;
+}
+
+inline void shm_unmap(ShmChannel *channel) {
+    munmap(channel, sizeof(ShmChannel));
+}
+
+// Server: create the segment for the client on `sock` and hand it over.
+inline ShmChannel *shm_accept(int sock) {
+    int fd = memfd_create("shmring", 0);
+    if (fd < 0)
+        return nullptr;
+    ShmChannel *channel = nullptr;
+    if (ftruncate(fd, sizeof(ShmChannel)) == 0)
+        channel = shm_map(fd);
+
+    char byte = 0;
+    struct iovec iov = {&byte, 1};
+    char control[CMSG_SPACE(sizeof(int))];
+    memset(control, 0, sizeof(control));
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+    if (channel && sendmsg(sock, &msg, MSG_NOSIGNAL) != 1) {
+        shm_unmap(channel);
+        channel = nullptr;
+    }
+    close(fd);
+    return channel;
+}
+
+// Client: connect to the server's socket at `path` and map the segment it
+// sends. `sock` must stay open while the channel is in use.
+inline ShmChannel *shm_connect(const char *path, int &sock) {
+    sock = unix_connect(path);
+    if (sock < 0)
+        return nullptr;
+
+    char byte;
+    struct iovec iov = {&byte, 1};
+    char control[CMSG_SPACE(sizeof(int))];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    ShmChannel *channel = nullptr;
+    if (recvmsg(sock, &msg, 0) == 1) {
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        if (cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            int fd;
+            memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+            channel = shm_map(fd);
+            close(fd);
+        }
+    }
+    if (!channel)
+        close(sock);
+    return channel;
+}
+
+#endif
@@ -0,0 +1,180 @@
+#! /usr/bin/env python3
+# Regression benchmark for the ns-3 scenarios. Runs final.cpp and the
+# sweeps (dumbbell included) on fixed seeds with --perf, adds up the "perf" lines each run
+# prints on stderr (simperf.h), and compares the totals with a baseline
+# saved by an earlier run. Sweeps run with --jobs=1 so that points do not
+# compete for cores. With --pcap it instead measures what packet capture
+# costs (pcapture.h): each sweep runs with and without --pcap, and the
+# table shows the run-time slowdown next to what was captured. Copy the
+# scenarios to the ns-3 scratch/ directory and build them first (see
+# README.md).
+import json
+import os
+import re
+import sys
+import time
+import shutil
+import tempfile
+import subprocess
+from optparse import OptionParser
+
+# (name, program, arguments): every run is deterministic given its seeds
+SUITE = [
+    ("final", "scratch/final", ["--linkDelay=100ms"]),
+    ("final_tcp1", "scratch/final_tcp1", ["--linkLatencies=10ms,100ms,500ms", "--seeds=1,2"]),
+    ("final_tcp2", "scratch/final_tcp2", ["--delayOptions=10ms,200ms", "--seeds=1",
+                                          "--tcpVariants=NewReno+NewReno,NewReno+Cubic"]),
+    ("final_udp1", "scratch/final_udp1", ["--delayOptions=10ms,200ms", "--seeds=1,2"]),
+    ("final_udp2", "scratch/final_udp2", ["--delayOptions=10ms,200ms", "--seeds=1,2"]),
+    ("dumbbell", "scratch/final_dumbbell", ["--senders=10,100", "--duration=10"]),
+]
+
+# Metrics where a larger value is a regression
+TIMES = ("wall_s", "setup_s", "run_s")
+PERF_LINE = re.compile(r"^perf .*$", re.MULTILINE)
+PCAP_LINE = re.compile(r"^pcap .*$", re.MULTILINE)
+# Scenarios that support --pcap
+PCAP_SCENARIOS = ("final_tcp1", "final_tcp2", "final_udp1", "final_udp2")
+
+
+def run_scenario(options, program, args):
+    """Run one scenario; returns the summed perf metrics of its points."""
+    if program != "scratch/final":
+        args = args + ["--jobs=1"]
+    command = [os.path.join(".", "ns3"), "run", "--no-build", " ".join([program] + args + ["--perf"])]
+    start = time.monotonic()
+    result = subprocess.run(command, cwd=options.ns3_dir, stdout=subprocess.DEVNULL,
+                            stderr=subprocess.PIPE)
+    wall = time.monotonic() - start
+    err = result.stderr.decode()
+    if result.returncode != 0:
+        sys.stderr.write(err)
+        raise RuntimeError("%s failed" % program)
+
+    totals = {"wall_s": wall, "setup_s": 0.0, "run_s": 0.0, "events": 0, "peak_rss_kb": 0,
+              "points": 0}
+    for line in PERF_LINE.findall(err):
+        fields = dict(item.split("=", 1) for item in line.split()[1:])
+        totals["setup_s"] += float(fields["setup_s"])
+        totals["run_s"] += float(fields["run_s"])
+        totals["events"] += int(fields["events"])
+        totals["peak_rss_kb"] = max(totals["peak_rss_kb"], int(fields["peak_rss_kb"]))
+        totals["points"] += 1
+    if totals["points"] == 0:
+        raise RuntimeError("%s printed no perf lines" % program)
+    for line in PCAP_LINE.findall(err):
+        fields = dict(item.split("=", 1) for item in line.split()[1:])
+        for key in ("captured", "raw_bytes", "file_bytes"):
+            totals[key] = totals.get(key, 0) + int(fields[key])
+        totals["stall_ms"] = totals.get("stall_ms", 0.0) + float(fields["stall_ms"])
+    totals["events_per_s"] = totals["events"] / totals["run_s"] if totals["run_s"] > 0 else 0
+    return totals
+
+
+def best_of(runs):
+    """Keep the fastest time of each kind over the repeats; the rest is fixed."""
+    best = dict(runs[0])
+    for key in TIMES:
+        best[key] = min(run[key] for run in runs)
+    best["events_per_s"] = best["events"] / best["run_s"] if best["run_s"] > 0 else 0
+    return best
+
+
+def compare(current, baseline, threshold):
+    """Return the regressions of one scenario against its baseline entry."""
+    problems = []
+    if current["events"] != baseline["events"]:
+        # The workload changed; its timings are not comparable any more.
+        problems.append("events %d -> %d" % (baseline["events"], current["events"]))
+        return problems
+    for key in TIMES:
+        if current[key] > baseline[key] * (1 + threshold):
+            problems.append("%s %+.0f%%" % (key, (current[key] / baseline[key] - 1) * 100))
+    if current["peak_rss_kb"] > baseline["peak_rss_kb"] * (1 + threshold):
+        problems.append("peak_rss_kb %+.0f%%" %
+                        ((current["peak_rss_kb"] / baseline["peak_rss_kb"] - 1) * 100))
+    return problems
+
+
+def pcap_overhead(options, only):
+    """Run time of every sweep without and with --pcap, and what was captured."""
+    directory = tempfile.mkdtemp(prefix="simbench-pcap-")
+    print("%-11s %9s %11s %9s %10s %9s %9s %10s" %
+          ("scenario", "run(s)", "pcap run(s)", "slowdown", "packets", "raw(MB)", "file(MB)",
+           "stall(ms)"))
+    try:
+        for name, program, args in SUITE:
+            if name not in PCAP_SCENARIOS or (only and name not in only):
+                continue
+            plain = best_of([run_scenario(options, program, args) for _ in range(options.repeat)])
+            pcap_args = args + ["--pcap=" + os.path.join(directory, name)] + options.pcap_args.split()
+            traced = best_of([run_scenario(options, program, pcap_args)
+                              for _ in range(options.repeat)])
+            print("%-11s %9.3f %11.3f %8.1f%% %10d %9.1f %9.1f %10.1f" %
+                  (name, plain["run_s"], traced["run_s"],
+                   (traced["run_s"] / plain["run_s"] - 1) * 100, traced["captured"],
+                   traced["raw_bytes"] / 1e6, traced["file_bytes"] / 1e6, traced["stall_ms"]))
+    finally:
+        shutil.rmtree(directory)
+    return 0
+
+
+def main(argv):
+    parser = OptionParser(usage="%prog [options]")
+    parser.add_option('--ns3-dir', default=".", dest='ns3_dir',
+                      help="ns-3 tree the scenarios are built in")
+    parser.add_option('--repeat', type="int", default=3, dest='repeat',
+                      help="Runs per scenario; the fastest counts")
+    parser.add_option('--baseline', dest='baseline',
+                      help="Compare with this saved result and exit 1 on a regression")
+    parser.add_option('--save', dest='save',
+                      help="Write this run's results to a file, for use as a baseline")
+    parser.add_option('--threshold', type="float", default=0.10, dest='threshold',
+                      help="Relative slowdown flagged as a regression")
+    parser.add_option('--only', default="", dest='only',
+                      help="Comma-separated scenarios to run (default: all)")
+    parser.add_option('--pcap', action="store_true", default=False, dest='pcap',
+                      help="Measure the slowdown from packet capture instead")
+    parser.add_option('--pcap-args', default="", dest='pcap_args',
+                      help="More capture options, e.g. \"--pcapSample=10 --pcapPort=8080\"")
+    (options, args) = parser.parse_args(argv[1:])
+    if args:
+        parser.error("unexpected arguments")
+    if options.pcap:
+        return pcap_overhead(options, set(filter(None, options.only.split(","))))
+
+    baseline = {}
+    if options.baseline:
+        with open(options.baseline) as f:
+            baseline = json.load(f)
+
+    only = set(filter(None, options.only.split(",")))
+    results = {}
+    regressions = 0
+    print("%-11s %7s %9s %9s %9s %12s %13s %12s  %s" %
+          ("scenario", "points", "wall(s)", "setup(s)", "run(s)", "events", "events/s",
+           "peak RSS(MB)", "vs baseline"))
+    for name, program, args in SUITE:
+        if only and name not in only:
+            continue
+        current = best_of([run_scenario(options, program, args) for _ in range(options.repeat)])
+        results[name] = current
+        if name not in baseline:
+            verdict = "-"
+        else:
+            problems = compare(current, baseline[name], options.threshold)
+            regressions += len(problems) > 0
+            verdict = "REGRESSION: " + ", ".join(problems) if problems else "ok"
+        print("%-11s %7d %9.3f %9.3f %9.3f %12d %13.0f %12.1f  %s" %
+              (name, current["points"], current["wall_s"], current["setup_s"], current["run_s"],
+               current["events"], current["events_per_s"], current["peak_rss_kb"] / 1024.0,
+               verdict))
+
+    if options.save:
+        with open(options.save, "w") as f:
+            json.dump(results, f, indent=2, sort_keys=True)
+    return 1 if regressions else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
@@ -0,0 +1,86 @@
+// Cost of one simulation run, for the scenarios' --perf option: wall time
+// spent building the topology versus inside Simulator::Run(), the events
+// the simulator executed and their rate, and the process's peak resident
+// set. ns-3 only counts executed events (Simulator::GetEventCount); events
+// still pending when the run stops are not included.
+//
+// The report is a single "perf key=value ..." line on stderr, written with
+// one call so that lines from parallel sweep workers do not interleave and
+// stdout keeps only the result rows. simbench.py parses these lines.
+#ifndef SIMPERF_H
+#define SIMPERF_H
+
+#include "ns3/core-module.h"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <sys/resource.h>
+
+#include "sweep.h"
+
+class SimProfile
+{
+  public:
+    // Call before the first node is created.
+    void SetupStarting()
+    {
+        m_setupStart = Clock::now();
+    }
+
+    // Call right before and right after Simulator::Run().
+    void RunStarting()
+    {
+        m_runStart = Clock::now();
+        m_eventsBefore = ns3::Simulator::GetEventCount();
+    }
+
+    void RunFinished()
+    {
+        m_runEnd = Clock::now();
+        m_events = ns3::Simulator::GetEventCount() - m_eventsBefore;
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        m_peakRssKb = usage.ru_maxrss;
+    }
+
+    // Distributed runs count per rank; Report() the sum of the events and
+    // the largest peak RSS over all ranks instead.
+    uint64_t Events() const { return m_events; }
+    long PeakRssKb() const { return m_peakRssKb; }
+    void SetTotals(uint64_t events, long peakRssKb)
+    {
+        m_events = events;
+        m_peakRssKb = peakRssKb;
+    }
+
+    void Report(const SweepPoint &point) const
+    {
+        double setup = std::chrono::duration<double>(m_runStart - m_setupStart).count();
+        double run = std::chrono::duration<double>(m_runEnd - m_runStart).count();
+
+        std::ostringstream line;
+        line << "perf delay=" << point.delay << " rate=" << point.rate << " seed=" << point.seed;
+        if (!point.variant.empty())
+        {
+            line << " variant=" << point.variant;
+        }
+        line << std::fixed << std::setprecision(6) << " setup_s=" << setup << " run_s=" << run
+             << " events=" << m_events << std::setprecision(0)
+             << " events_per_s=" << (run > 0 ? m_events / run : 0)
+             << " peak_rss_kb=" << m_peakRssKb << "\n";
+        std::cerr << line.str() << std::flush;
+    }
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    Clock::time_point m_setupStart, m_runStart, m_runEnd;
+    uint64_t m_eventsBefore = 0;
+    uint64_t m_events = 0;
+    long m_peakRssKb = 0;
+};
+
+#endif
@@ -0,0 +1,104 @@
+// TCP socket buffer sizing for server.cpp and client.cpp (-w). A buffer is
+// given either in bytes or as the path it has to fill, "MBPS:RTT_MS", in
+// which case it is sized to SOCKBUF_BDP_MULTIPLE bandwidth-delay products:
+// one BDP of data in flight plus room for the receiver to fall behind.
+// Setting SO_SNDBUF/SO_RCVBUF switches off the kernel's autotuning for the
+// socket, so leaving -w out keeps the default behaviour. The receive buffer
+// must be set before connect()/listen(), because the window scale is fixed
+// in the SYN exchange.
+#ifndef SOCKBUF_H
+#define SOCKBUF_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sys/socket.h>
+
+#define SOCKBUF_BDP_MULTIPLE 2
+
+struct SocketBufferSpec {
+    int bytes = 0;          // 0 = kernel autotuning
+    double mbps = 0;        // path the buffer was sized for, 0 if given in bytes
+    double rtt_ms = 0;
+    uint64_t bdp_bytes = 0;
+};
+
+// Parse "BYTES" or "MBPS:RTT_MS". Returns false on malformed input or a
+// size that does not fit a socket option.
+static inline bool parse_socket_buffer(const char *text, SocketBufferSpec &spec) {
+    char *end;
+    double first = strtod(text, &end);
+    if (end == text || first <= 0)
+        return false;
+    if (*end == '\0') {
+        spec = SocketBufferSpec();
+        spec.bytes = first <= (1 << 30) ? (int)first : 0;
+        return spec.bytes > 0;
+    }
+    if (*end != ':')
+        return false;
+    const char *rtt_text = end + 1;
+    double rtt_ms = strtod(rtt_text, &end);
+    if (end == rtt_text || *end != '\0' || rtt_ms <= 0)
+        return false;
+    spec.mbps = first;
+    spec.rtt_ms = rtt_ms;
+    spec.bdp_bytes = (uint64_t)(first * 1e6 / 8 * rtt_ms / 1e3);
+    uint64_t bytes = spec.bdp_bytes * SOCKBUF_BDP_MULTIPLE;
+    if (bytes > (1 << 30))
+        return false;
+    spec.bytes = bytes < 4096 ? 4096 : (int)bytes;
+    return true;
+}
+
+// Set one buffer, past net.core.[rw]mem_max if the process may
+// (CAP_NET_ADMIN), else as far as the limit allows.
+static inline void set_socket_buffer(int fd, int option, int force_option, int bytes) {
+    if (setsockopt(fd, SOL_SOCKET, force_option, &bytes, sizeof(bytes)) < 0)
+        setsockopt(fd, SOL_SOCKET, option, &bytes, sizeof(bytes));
+}
+
+// Apply `spec` to both directions of `fd`; a no-op for autotuning.
+static inline void apply_socket_buffers(int fd, const SocketBufferSpec &spec) {
+    if (spec.bytes <= 0)
+        return;
+    set_socket_buffer(fd, SO_SNDBUF, SO_SNDBUFFORCE, spec.bytes);
+    set_socket_buffer(fd, SO_RCVBUF, SO_RCVBUFFORCE, spec.bytes);
+}
+
+// Throughput one connection can reach with `window` bytes in flight per
+// round trip, capped by the path rate. Only meaningful for MBPS:RTT_MS specs.
+static inline double socket_buffer_limit_mbps(const SocketBufferSpec &spec, int window) {
+    double mbps = window * 8.0 / (spec.rtt_ms / 1e3) / 1e6;
+    return mbps < spec.mbps ? mbps : spec.mbps;
+}
+
+// Report what the kernel made of `spec` on `fd` (it doubles a request for
+// bookkeeping and reports that), warning when it was capped below the
+// request. Returns the smaller usable size.
+static inline int print_socket_buffers(int fd, const SocketBufferSpec &spec) {
+    int snd = 0, rcv = 0;
+    socklen_t len = sizeof(snd);
+    getsockopt(fd, SOL_SOCKET, SO_SNDBUF, &snd, &len);
+    len = sizeof(rcv);
+    getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcv, &len);
+    snd /= 2;
+    rcv /= 2;
+    int window = snd < rcv ? snd : rcv;
+
+    std::cout << "socket buffers: " << spec.bytes << " bytes requested";
+    if (spec.mbps > 0)
+        std::cout << " (" << SOCKBUF_BDP_MULTIPLE << " x BDP " << spec.bdp_bytes << " of " << spec.mbps
+                  << " Mbit/s at " << spec.rtt_ms << " ms RTT)";
+    std::cout << ", send " << snd << " / receive " << rcv << " in effect\n";
+    if (window < spec.bytes) {
+        std::cerr << "warning: socket buffers capped by net.core.wmem_max/rmem_max";
+        if (spec.mbps > 0)
+            std::cerr << ", window limits throughput to " << socket_buffer_limit_mbps(spec, window) << " Mbit/s";
+        std::cerr << "\n";
+    }
+    return window;
+}
+
+#endif
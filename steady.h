@@ -0,0 +1,169 @@
+// Adaptive run length for the sweep scenarios (--adaptive). Instead of a
+// fixed duration, the run samples every flow's throughput once per interval
+// from the moment all flows are active and stops as soon as, for every
+// flow, the 95% confidence interval of the mean over the last `window`
+// samples is narrower than `tolerance` of that mean. A path that settles
+// quickly stops after a few seconds; one that does not runs on until
+// maxDuration. Each sample is the mean over one interval, so consecutive
+// samples are batch means; intervals much shorter than an RTT correlate
+// them and make the interval optimistic.
+//
+// The outcome is a single "steady key=value ..." line on stderr, written
+// like the perf line (see simperf.h) so the result rows keep their format.
+#ifndef STEADY_H
+#define STEADY_H
+
+#include "ns3/core-module.h"
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+#include "results.h"
+#include "sweep.h"
+
+struct SteadyStateOptions
+{
+    bool enabled = false;
+    double interval = 0.5;        // seconds per throughput sample
+    uint32_t window = 8;          // samples the confidence interval covers
+    double tolerance = 0.02;      // CI half-width, relative to the mean
+    double maxDuration = 60.0;    // simulated seconds at most
+};
+
+inline void
+AddSteadyStateOptions(ns3::CommandLine &cmd, SteadyStateOptions &options)
+{
+    cmd.AddValue("adaptive", "Stop each run once throughput is steady instead of after --duration", options.enabled);
+    cmd.AddValue("steadyInterval", "Throughput sampling period of --adaptive (seconds)", options.interval);
+    cmd.AddValue("steadyWindow", "Samples in the sliding window of --adaptive (at least 2)", options.window);
+    cmd.AddValue("steadyTolerance", "95% confidence half-width, relative to the mean, that counts as steady", options.tolerance);
+    cmd.AddValue("maxDuration", "Longest run with --adaptive (simulated seconds)", options.maxDuration);
+}
+
+// Time the applications and the simulation must be able to run to.
+inline double
+SteadyStateCap(const SteadyStateOptions &options, double duration)
+{
+    return options.enabled ? options.maxDuration : duration;
+}
+
+class SteadyStateStop
+{
+  public:
+    // Start sampling at allActive; once steady, call onSteady, which stops
+    // the simulation (directly, or after letting the senders drain).
+    void Start(const SteadyStateOptions &options,
+               FlowByteCounter counter,
+               ns3::Time allActive,
+               std::function<void()> onSteady)
+    {
+        m_options = options;
+        m_options.window = std::max<uint32_t>(options.window, 2);
+        m_counter = counter;
+        m_onSteady = onSteady;
+        ns3::Simulator::Schedule(allActive, &SteadyStateStop::Sample, this);
+    }
+
+    // The outcome of the run; call after Simulator::Run(), before Destroy().
+    void Report(const SweepPoint &point) const
+    {
+        std::ostringstream line;
+        line << "steady delay=" << point.delay << " rate=" << point.rate << " seed=" << point.seed;
+        if (!point.variant.empty())
+        {
+            line << " variant=" << point.variant;
+        }
+        line << " converged=" << (m_converged ? 1 : 0) << std::fixed << std::setprecision(3)
+             << " steady_s=" << (m_converged ? m_steadyAt.GetSeconds() : 0.0)
+             << " end_s=" << ns3::Simulator::Now().GetSeconds()
+             << " ci_percent=" << m_worstHalfWidth * 100 << " samples=" << m_samples << "\n";
+        std::cerr << line.str() << std::flush;
+    }
+
+  private:
+    // Two-sided 95% quantile of Student's t with n - 1 degrees of freedom
+    static double TQuantile(size_t n)
+    {
+        static const double t[] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306,
+                                   2.262, 2.228, 2.201, 2.179, 2.160, 2.145, 2.131, 2.120,
+                                   2.110, 2.101, 2.093, 2.086, 2.080, 2.074, 2.069, 2.064,
+                                   2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+        return n - 1 <= sizeof(t) / sizeof(t[0]) ? t[n - 2] : 1.960;
+    }
+
+    // Half-width of the confidence interval relative to the mean; infinite
+    // while the window is not full or the flow delivers nothing.
+    double RelativeHalfWidth(const std::deque<double> &rates) const
+    {
+        size_t n = rates.size();
+        if (n < m_options.window)
+        {
+            return INFINITY;
+        }
+        double mean = 0;
+        for (double rate : rates)
+        {
+            mean += rate;
+        }
+        mean /= n;
+        if (mean <= 0)
+        {
+            return INFINITY;
+        }
+        double squares = 0;
+        for (double rate : rates)
+        {
+            squares += (rate - mean) * (rate - mean);
+        }
+        return TQuantile(n) * std::sqrt(squares / (n - 1) / n) / mean;
+    }
+
+    void Sample()
+    {
+        std::map<ns3::FlowId, uint64_t> bytes = m_counter();
+        if (m_samples++ > 0)
+        {
+            for (const auto &flow : bytes)
+            {
+                std::deque<double> &rates = m_rates[flow.first];
+                rates.push_back((flow.second - m_last[flow.first]) * 8.0 / m_options.interval);
+                if (rates.size() > m_options.window)
+                {
+                    rates.pop_front();
+                }
+            }
+            m_worstHalfWidth = 0;
+            for (const auto &flow : m_rates)
+            {
+                m_worstHalfWidth = std::max(m_worstHalfWidth, RelativeHalfWidth(flow.second));
+            }
+            if (!m_rates.empty() && m_worstHalfWidth < m_options.tolerance)
+            {
+                m_converged = true;
+                m_steadyAt = ns3::Simulator::Now();
+                m_onSteady();
+                return;
+            }
+        }
+        m_last = bytes;
+        ns3::Simulator::Schedule(ns3::Seconds(m_options.interval), &SteadyStateStop::Sample, this);
+    }
+
+    SteadyStateOptions m_options;
+    FlowByteCounter m_counter;
+    std::function<void()> m_onSteady;
+    std::map<ns3::FlowId, uint64_t> m_last;
+    std::map<ns3::FlowId, std::deque<double>> m_rates;
+    uint32_t m_samples = 0;
+    double m_worstHalfWidth = INFINITY;
+    bool m_converged = false;
+    ns3::Time m_steadyAt;
+};
+
+#endif
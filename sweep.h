@@ -0,0 +1,182 @@
+// Parameter sweeps for the ns-3 scenarios (final_tcp*, final_udp*, final_dumbbell).
+//
+// ns-3's Simulator is a process-wide singleton, so sweep points cannot run
+// on threads. Instead every (delay, rate, variant, seed) point runs in its own
+// forked worker, at most `jobs` at a time. What a worker prints to stdout
+// is captured through a pipe, and the collected output is printed in grid
+// order once every point is done, so the table reads the same no matter
+// which worker finishes first.
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+struct SweepPoint
+{
+    std::string delay;  // e.g. "10ms"
+    std::string rate;   // e.g. "5Mbps"
+    uint32_t seed;
+    std::string variant; // scenario-specific extra dimension, empty if unused
+};
+
+// Split a comma-separated command-line list, dropping empty items.
+inline std::vector<std::string>
+SplitList(const std::string &list)
+{
+    std::vector<std::string> items;
+    std::stringstream in(list);
+    std::string item;
+    while (std::getline(in, item, ','))
+    {
+        if (!item.empty())
+        {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+// Every combination of the given delays, rates, variants and seeds,
+// delay-major. An empty variant list sweeps a single empty variant.
+inline std::vector<SweepPoint>
+MakeSweepGrid(const std::string &delays,
+              const std::string &rates,
+              const std::string &seeds,
+              const std::vector<std::string> &variants = {""})
+{
+    std::vector<SweepPoint> points;
+    for (const std::string &delay : SplitList(delays))
+    {
+        for (const std::string &rate : SplitList(rates))
+        {
+            for (const std::string &variant : variants)
+            {
+                for (const std::string &seed : SplitList(seeds))
+                {
+                    points.push_back(
+                        {delay, rate, (uint32_t)std::strtoul(seed.c_str(), nullptr, 10), variant});
+                }
+            }
+        }
+    }
+    return points;
+}
+
+// Run runPoint(point) for every point, each in a child process, with up to
+// `jobs` children at once (0 = one per online CPU). Prints the children's
+// output in point order and returns the number of points that failed.
+template <class Fn>
+int
+RunSweep(const std::vector<SweepPoint> &points, int jobs, Fn runPoint)
+{
+    struct Worker
+    {
+        pid_t pid;
+        int fd;
+        size_t index;
+    };
+
+    if (jobs <= 0)
+    {
+        jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    std::vector<std::string> output(points.size());
+    std::vector<Worker> running;
+    size_t next = 0;
+    int failed = 0;
+
+    while (next < points.size() || !running.empty())
+    {
+        while ((int)running.size() < jobs && next < points.size())
+        {
+            int fds[2];
+            std::cout.flush(); // nothing buffered may be duplicated into the child
+            if (pipe(fds) < 0)
+            {
+                std::cerr << "pipe failed for point " << next << std::endl;
+                failed++;
+                next++;
+                continue;
+            }
+            pid_t pid = fork();
+            if (pid == 0)
+            {
+                close(fds[0]);
+                dup2(fds[1], STDOUT_FILENO);
+                close(fds[1]);
+                runPoint(points[next]);
+                std::cout.flush();
+                _exit(0);
+            }
+            close(fds[1]);
+            if (pid < 0)
+            {
+                std::cerr << "fork failed for point " << next << std::endl;
+                close(fds[0]);
+                failed++;
+                next++;
+                continue;
+            }
+            running.push_back({pid, fds[0], next++});
+        }
+        if (running.empty())
+        {
+            continue;
+        }
+
+        // Drain whichever workers have output; a worker is done at EOF.
+        std::vector<struct pollfd> pfds;
+        for (const Worker &w : running)
+        {
+            pfds.push_back({w.fd, POLLIN, 0});
+        }
+        if (poll(pfds.data(), pfds.size(), -1) < 0)
+        {
+            continue;
+        }
+        for (size_t i = pfds.size(); i-- > 0;)
+        {
+            if (!pfds[i].revents)
+            {
+                continue;
+            }
+            Worker &w = running[i];
+            char buffer[4096];
+            ssize_t n = read(w.fd, buffer, sizeof(buffer));
+            if (n > 0)
+            {
+                output[w.index].append(buffer, n);
+                continue;
+            }
+            close(w.fd);
+            int status;
+            waitpid(w.pid, &status, 0);
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            {
+                const SweepPoint &p = points[w.index];
+                std::cerr << "Point delay=" << p.delay << " rate=" << p.rate << " seed=" << p.seed
+                          << (p.variant.empty() ? "" : " variant=" + p.variant) << " failed"
+                          << std::endl;
+                failed++;
+            }
+            running.erase(running.begin() + i);
+        }
+    }
+
+    for (const std::string &text : output)
+    {
+        std::cout << text;
+    }
+    std::cout.flush();
+    return failed;
+}
+
+#endif
@@ -0,0 +1,81 @@
+// Bandwidth-delay-product sizing of TCP for the ns-3 scenarios. ns-3's
+// defaults (128 KB socket buffers, 536-byte segments) cap the window well
+// below the BDP of long paths: at 5 Mbps and 500 ms one-way delay the
+// receive buffer alone allows about 1 Mbps. With a plan applied the socket
+// buffers hold TCPBDP_MULTIPLE BDPs, segments fill the link MTU and window
+// scaling is on, so a sweep measures the link instead of the buffers.
+// Scenarios that pick a congestion control name it through TcpTypeName.
+#ifndef TCPBDP_H
+#define TCPBDP_H
+
+#include "ns3/core-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/network-module.h"
+
+#include <algorithm>
+#include <string>
+
+#define TCPBDP_MULTIPLE 2          // socket buffers hold this many BDPs
+#define TCPBDP_HEADERS 52          // IPv4 (20) + TCP with timestamps (32) per segment
+
+struct TcpPlan
+{
+    double rttSeconds;      // propagation only: twice the one-way delay
+    uint64_t linkBps;
+    uint64_t bdpBytes;
+    uint32_t bufferBytes;   // SndBufSize and RcvBufSize
+    uint32_t segmentBytes;  // SegmentSize
+};
+
+// "Cubic" and "ns3::TcpCubic" both name ns3::TcpCubic.
+inline std::string
+TcpTypeName(const std::string &name)
+{
+    return name.compare(0, 5, "ns3::") == 0 ? name : "ns3::Tcp" + name;
+}
+
+// What TCP runs with when nothing is changed: ns-3's attribute defaults.
+inline TcpPlan
+DefaultTcpPlan(const std::string &rate, const std::string &delay)
+{
+    TcpPlan plan;
+    plan.rttSeconds = 2 * ns3::Time(delay).GetSeconds();
+    plan.linkBps = ns3::DataRate(rate).GetBitRate();
+    plan.bdpBytes = plan.linkBps / 8 * plan.rttSeconds;
+    plan.bufferBytes = 131072;
+    plan.segmentBytes = 536;
+    return plan;
+}
+
+// Buffers sized from the path, segments from the link MTU. Buffers never
+// shrink below the defaults.
+inline TcpPlan
+BdpTcpPlan(const std::string &rate, const std::string &delay, uint32_t mtu)
+{
+    TcpPlan plan = DefaultTcpPlan(rate, delay);
+    plan.bufferBytes = std::max<uint64_t>(plan.bufferBytes, TCPBDP_MULTIPLE * plan.bdpBytes);
+    plan.segmentBytes = mtu - TCPBDP_HEADERS;
+    return plan;
+}
+
+// Make the plan the default for every TCP socket created afterwards.
+inline void
+ApplyTcpPlan(const TcpPlan &plan)
+{
+    ns3::Config::SetDefault("ns3::TcpSocket::SndBufSize", ns3::UintegerValue(plan.bufferBytes));
+    ns3::Config::SetDefault("ns3::TcpSocket::RcvBufSize", ns3::UintegerValue(plan.bufferBytes));
+    ns3::Config::SetDefault("ns3::TcpSocket::SegmentSize", ns3::UintegerValue(plan.segmentBytes));
+    ns3::Config::SetDefault("ns3::TcpSocketBase::WindowScaling", ns3::BooleanValue(true));
+}
+
+// Best steady-state rate of one flow, in Mbps of IP bytes: the link rate,
+// unless a window of bufferBytes per round trip is less.
+inline double
+TheoreticalMbps(const TcpPlan &plan)
+{
+    double linkMbps = plan.linkBps / 1e6;
+    double windowMbps = plan.bufferBytes * 8.0 / plan.rttSeconds / 1e6;
+    return std::min(linkMbps, windowMbps);
+}
+
+#endif
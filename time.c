@@ -1,29 +1,493 @@
+// Repeatable command timer. Runs a command W times to warm up, then K
+// measured times, reaping each run with wait4 to collect its resource
+// usage, and prints mean, stddev, min and median of every metric:
+//
+//     gcc -O2 -o timecmd time.c -lm
+//     ./timecmd -w 2 -n 10 -q -c runs.csv -- ./ns3-scenario --linkRate=10Mbps
+//
+// A run that does not exit with status 0 aborts the measurement.
+//
+// With -s MS the timer also samples the command every MS milliseconds
+// while it runs and writes a timeline (-t, timeline.csv by default). Each
+// row covers one interval:
+//
+// - processes alive and their total RSS
+// - user and system CPU time used, and CPU percent
+// - voluntary and involuntary context switches
+// - bytes read from and written to storage
+//
+// A sample covers the command's whole process tree, found through
+// /proc/PID/task/TID/children, since sweeps fork workers and wrappers such
+// as `./ns3 run` start the real program as a child. CPU time includes
+// descendants that have exited (cutime/cstime). Context switches and I/O
+// are those of live processes, so deltas are clamped at zero when one
+// exits. Between samples the timer sleeps in sigtimedwait on SIGCHLD, so
+// an exit is noticed at once and wall time is unaffected. The summary
+// reports the CPU the sampling loop used itself.
 #include <stdio.h>
-#include<stdlib.h>
+#include <stdlib.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <math.h>
+#include <time.h>
+#include <dirent.h>
+#include <signal.h>
 #include <sys/types.h>
 #include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
 #include <string.h>
+#include <errno.h>
 
-int main(int argc, char* argv[]){
-    struct timeval start_time, end_time;
-    if(argc<2){
-        printf("Fewer arguments than expected");
-        return 1;
+enum { WALL, USER, SYS, MAXRSS, VCSW, IVCSW, METRICS };
+
+static const char *metric_names[METRICS] = {
+    "wall_s", "user_s", "sys_s", "maxrss_kb", "voluntary_csw", "involuntary_csw",
+};
+
+struct run {
+    double value[METRICS];
+};
+
+struct summary {
+    double mean, stddev, min, median;
+};
+
+static double seconds(struct timeval tv) {
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// CPU time this process has used, in seconds.
+static double cpu_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// ---------------------------------------------------------------------------
+// Resource timeline (-s)
+// ---------------------------------------------------------------------------
+
+enum { T_PROCS, T_RSS, T_USER, T_SYS, T_VCSW, T_IVCSW, T_READ, T_WRITE, T_FIELDS };
+
+// Totals over a process tree at one instant.
+struct sample {
+    double value[T_FIELDS];
+};
+
+struct sampler {
+    double interval;        // seconds
+    FILE *timeline;
+    int run;                // measured run the next samples belong to
+    long samples;
+    double sampled_wall;    // wall time of the sampled runs
+    double cpu;             // CPU time spent taking and writing samples
+    double peak_rss_kb;     // of the whole tree
+    double peak_cpu_pct;
+};
+
+static double clock_ticks, page_kb;
+static sigset_t original_mask;      // restored in the child before exec
+
+static int read_proc(const char *path, char *buf, size_t size) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    ssize_t n = read(fd, buf, size - 1);
+    close(fd);
+    if (n < 0)
+        return -1;
+    buf[n] = '\0';
+    return 0;
+}
+
+// Value of the line starting with `key` in a /proc "key: value" file.
+static double proc_field(const char *text, const char *key) {
+    const char *line = strstr(text, key);
+    return line ? strtod(line + strlen(key), NULL) : 0;
+}
+
+static void sample_process(pid_t pid, struct sample *s) {
+    char path[64], buf[1024];
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+    if (read_proc(path, buf, sizeof(buf)) < 0)
+        return;
+    // The command name may hold spaces; the fields start after its ')'.
+    char *fields = strrchr(buf, ')');
+    unsigned long utime, stime;
+    long cutime, cstime, rss;
+    if (!fields || sscanf(fields + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu %ld %ld "
+                                      "%*d %*d %*d %*d %*u %*u %ld",
+                          &utime, &stime, &cutime, &cstime, &rss) != 5)
+        return;
+    s->value[T_PROCS] += 1;
+    s->value[T_RSS] += rss * page_kb;
+    s->value[T_USER] += (utime + cutime) / clock_ticks;
+    s->value[T_SYS] += (stime + cstime) / clock_ticks;
+
+    snprintf(path, sizeof(path), "/proc/%d/io", (int)pid);
+    if (read_proc(path, buf, sizeof(buf)) == 0) {
+        s->value[T_READ] += proc_field(buf, "\nread_bytes:");
+        s->value[T_WRITE] += proc_field(buf, "\nwrite_bytes:");
+    }
+}
+
+// Add `pid` and all its descendants to `s`. Context switches are counted
+// per thread, and every thread may have children of its own.
+static void sample_tree(pid_t pid, struct sample *s, int depth) {
+    char path[64], buf[4096];
+    sample_process(pid, s);
+    if (depth > 64)
+        return;
+
+    snprintf(path, sizeof(path), "/proc/%d/task", (int)pid);
+    DIR *tasks = opendir(path);
+    if (!tasks)
+        return;
+    struct dirent *task;
+    while ((task = readdir(tasks)) != NULL) {
+        if (task->d_name[0] == '.')
+            continue;
+        snprintf(path, sizeof(path), "/proc/%d/task/%.16s/status", (int)pid, task->d_name);
+        if (read_proc(path, buf, sizeof(buf)) == 0) {
+            s->value[T_VCSW] += proc_field(buf, "\nvoluntary_ctxt_switches:");
+            s->value[T_IVCSW] += proc_field(buf, "\nnonvoluntary_ctxt_switches:");
+        }
+        snprintf(path, sizeof(path), "/proc/%d/task/%.16s/children", (int)pid, task->d_name);
+        if (read_proc(path, buf, sizeof(buf)) < 0)
+            continue;
+        char *p = buf, *end;
+        long child;
+        while ((child = strtol(p, &end, 10)) > 0) {
+            sample_tree((pid_t)child, s, depth + 1);
+            p = end;
+        }
+    }
+    closedir(tasks);
+}
+
+// One timeline row: the change from `prev` to `cur` over `dt` seconds.
+static void write_sample(struct sampler *sp, double t, double dt, const struct sample *prev,
+                         const struct sample *cur) {
+    double d[T_FIELDS];
+    for (int f = 0; f < T_FIELDS; f++) {
+        d[f] = cur->value[f] - prev->value[f];
+        if (d[f] < 0)
+            d[f] = 0;
     }
-    char command[200];
-    strcpy(command, argv[1]);
-    pid_t pid;
-    pid = fork();
+    double cpu_pct = dt > 0 ? (d[T_USER] + d[T_SYS]) / dt * 100 : 0;
+    fprintf(sp->timeline, "%d,%.3f,%.0f,%.0f,%.3f,%.3f,%.1f,%.0f,%.0f,%.0f,%.0f\n", sp->run, t,
+            cur->value[T_PROCS], cur->value[T_RSS], d[T_USER], d[T_SYS], cpu_pct, d[T_VCSW],
+            d[T_IVCSW], d[T_READ], d[T_WRITE]);
+    sp->samples++;
+    if (cur->value[T_RSS] > sp->peak_rss_kb)
+        sp->peak_rss_kb = cur->value[T_RSS];
+    if (cpu_pct > sp->peak_cpu_pct)
+        sp->peak_cpu_pct = cpu_pct;
+}
+
+// Whether `pid` has exited. WNOWAIT leaves it to be reaped by wait4.
+static int has_exited(pid_t pid) {
+    siginfo_t info;
+    info.si_pid = 0;
+    return waitid(P_PID, pid, &info, WEXITED | WNOHANG | WNOWAIT) < 0 || info.si_pid == pid;
+}
+
+// Discard SIGCHLDs left pending by earlier runs, unsampled warmups
+// included, so that the next one belongs to the next child.
+static void drain_sigchld(void) {
+    sigset_t chld;
+    sigemptyset(&chld);
+    sigaddset(&chld, SIGCHLD);
+    struct timespec zero = {0, 0};
+    while (sigtimedwait(&chld, NULL, &zero) == SIGCHLD)
+        ;
+}
+
+// Sample the tree under `pid` every interval until it exits. SIGCHLD is
+// blocked (see main), so it stays pending until sigtimedwait takes it.
+static void sample_until_exit(pid_t pid, double start, struct sampler *sp) {
+    sigset_t chld;
+    sigemptyset(&chld);
+    sigaddset(&chld, SIGCHLD);
+    struct sample prev;
+    memset(&prev, 0, sizeof(prev));
+    double last = start, next = start + sp->interval;
+
+    while (1) {
+        double left = next - now();
+        if (left > 0) {
+            struct timespec ts;
+            ts.tv_sec = (time_t)left;
+            ts.tv_nsec = (long)((left - ts.tv_sec) * 1e9);
+            int sig = sigtimedwait(&chld, NULL, &ts);
+            if (sig == SIGCHLD && has_exited(pid))
+                break;
+            if (sig == SIGCHLD)
+                continue;
+            if (sig < 0 && errno == EINTR)
+                continue;
+            if (sig < 0 && errno != EAGAIN)
+                break;
+        }
+        double cpu = cpu_now();
+        struct sample cur;
+        memset(&cur, 0, sizeof(cur));
+        sample_tree(pid, &cur, 0);
+        double t = now();
+        write_sample(sp, t - start, t - last, &prev, &cur);
+        prev = cur;
+        last = t;
+        sp->cpu += cpu_now() - cpu;
+        // Skip intervals missed while the machine was overloaded
+        next += sp->interval;
+        if (next < t)
+            next = t + sp->interval;
+    }
+    sp->sampled_wall += now() - start;
+}
 
-    if(pid<0){
-        printf("Fork not successful\n");
-        return 2;
+// Run the command once. Returns 0 and fills `r` on success, -1 if it could
+// not be started or did not exit cleanly. Samples it while it runs if
+// `sampler` is given.
+static int run_once(char **command, int quiet, struct sampler *sampler, struct run *r) {
+    drain_sigchld();
+    double start = now();
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return -1;
     }
-    else if(pid == 0){
+    if (pid == 0) {
         // inside child process
+        sigprocmask(SIG_SETMASK, &original_mask, NULL);
+        if (quiet) {
+            int devnull = open("/dev/null", O_WRONLY);
+            if (devnull >= 0) {
+                dup2(devnull, STDOUT_FILENO);
+                close(devnull);
+            }
+        }
+        execvp(command[0], command);
+        fprintf(stderr, "Cannot run %s: %s\n", command[0], strerror(errno));
+        _exit(127);
+    }
+
+    if (sampler)
+        sample_until_exit(pid, start, sampler);
+    int status;
+    struct rusage ru;
+    if (wait4(pid, &status, 0, &ru) < 0) {
+        perror("wait4");
+        return -1;
+    }
+    double end = now();
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        if (WIFSIGNALED(status))
+            fprintf(stderr, "%s killed by signal %d\n", command[0], WTERMSIG(status));
+        else
+            fprintf(stderr, "%s exited with status %d\n", command[0], WEXITSTATUS(status));
+        return -1;
+    }
+
+    r->value[WALL] = end - start;
+    r->value[USER] = seconds(ru.ru_utime);
+    r->value[SYS] = seconds(ru.ru_stime);
+    r->value[MAXRSS] = ru.ru_maxrss;
+    r->value[VCSW] = ru.ru_nvcsw;
+    r->value[IVCSW] = ru.ru_nivcsw;
+    return 0;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Sample statistics of one metric over all measured runs.
+static struct summary summarize(const struct run *runs, int n, int metric) {
+    struct summary s;
+    double *values = malloc(n * sizeof(double));
+    double sum = 0;
+    for (int i = 0; i < n; i++) {
+        values[i] = runs[i].value[metric];
+        sum += values[i];
+    }
+    s.mean = sum / n;
+
+    double squares = 0;
+    for (int i = 0; i < n; i++)
+        squares += (values[i] - s.mean) * (values[i] - s.mean);
+    s.stddev = n > 1 ? sqrt(squares / (n - 1)) : 0;
+
+    qsort(values, n, sizeof(double), compare_doubles);
+    s.min = values[0];
+    s.median = n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+    free(values);
+    return s;
+}
+
+static int write_csv(const char *path, const struct run *runs, int n) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    fprintf(f, "run");
+    for (int m = 0; m < METRICS; m++)
+        fprintf(f, ",%s", metric_names[m]);
+    fprintf(f, "\n");
+    for (int i = 0; i < n; i++) {
+        fprintf(f, "%d", i + 1);
+        for (int m = 0; m < METRICS; m++)
+            fprintf(f, ",%.6f", runs[i].value[m]);
+        fprintf(f, "\n");
+    }
+    fclose(f);
+    return 0;
+}
+
+static void json_string(FILE *f, const char *s) {
+    fputc('"', f);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\')
+            fprintf(f, "\\%c", *s);
+        else if ((unsigned char)*s < 0x20)
+            fprintf(f, "\\u%04x", *s);
+        else
+            fputc(*s, f);
+    }
+    fputc('"', f);
+}
 
+static int write_json(const char *path, char **command, int warmup, const struct run *runs, int n) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    fprintf(f, "{\n  \"command\": [");
+    for (int i = 0; command[i]; i++) {
+        if (i)
+            fprintf(f, ", ");
+        json_string(f, command[i]);
+    }
+    fprintf(f, "],\n  \"warmup\": %d,\n  \"runs\": [\n", warmup);
+    for (int i = 0; i < n; i++) {
+        fprintf(f, "    {");
+        for (int m = 0; m < METRICS; m++)
+            fprintf(f, "%s\"%s\": %.6f", m ? ", " : "", metric_names[m], runs[i].value[m]);
+        fprintf(f, "}%s\n", i + 1 < n ? "," : "");
     }
+    fprintf(f, "  ],\n  \"summary\": {\n");
+    for (int m = 0; m < METRICS; m++) {
+        struct summary s = summarize(runs, n, m);
+        fprintf(f, "    \"%s\": {\"mean\": %.6f, \"stddev\": %.6f, \"min\": %.6f, \"median\": %.6f}%s\n",
+                metric_names[m], s.mean, s.stddev, s.min, s.median, m + 1 < METRICS ? "," : "");
+    }
+    fprintf(f, "  }\n}\n");
+    fclose(f);
+    return 0;
+}
 
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-w warmup] [-n runs] [-q] [-c file.csv] [-j file.json] [-s ms [-t file.csv]]\n"
+            "       [--] command [args...]\n"
+            "  -w  untimed warmup runs (default 1)\n"
+            "  -n  measured runs (default 10)\n"
+            "  -q  discard the command's stdout\n"
+            "  -c  write one CSV row per measured run\n"
+            "  -j  write the runs and the summary as JSON\n"
+            "  -s  sample the measured runs' process tree every ms milliseconds\n"
+            "  -t  timeline of the samples (default timeline.csv)\n",
+            prog);
 }
 
+int main(int argc, char* argv[]){
+    int warmup = 1, runs_wanted = 10, quiet = 0;
+    const char *csv = NULL, *json = NULL, *timeline = "timeline.csv";
+    double interval_ms = 0;
+
+    // '+' stops at the first non-option, so the command keeps its own flags.
+    int opt;
+    while ((opt = getopt(argc, argv, "+w:n:qc:j:s:t:")) != -1) {
+        switch (opt) {
+        case 'w': warmup = atoi(optarg); break;
+        case 'n': runs_wanted = atoi(optarg); break;
+        case 'q': quiet = 1; break;
+        case 'c': csv = optarg; break;
+        case 'j': json = optarg; break;
+        case 's': interval_ms = atof(optarg); break;
+        case 't': timeline = optarg; break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if(optind >= argc || warmup < 0 || runs_wanted < 1 || interval_ms < 0){
+        usage(argv[0]);
+        return 1;
+    }
+    char **command = argv + optind;
+
+    struct sampler sampler;
+    memset(&sampler, 0, sizeof(sampler));
+    if (interval_ms > 0) {
+        sampler.interval = interval_ms / 1e3;
+        sampler.timeline = fopen(timeline, "w");
+        if (!sampler.timeline) {
+            perror(timeline);
+            return 1;
+        }
+        fprintf(sampler.timeline, "run,t_s,procs,rss_kb,user_s,sys_s,cpu_pct,voluntary_csw,"
+                                  "involuntary_csw,read_bytes,write_bytes\n");
+        clock_ticks = sysconf(_SC_CLK_TCK);
+        page_kb = sysconf(_SC_PAGESIZE) / 1024.0;
+        sigset_t chld;
+        sigemptyset(&chld);
+        sigaddset(&chld, SIGCHLD);
+        sigprocmask(SIG_BLOCK, &chld, &original_mask);
+    }
+
+    struct run *runs = malloc(runs_wanted * sizeof(struct run));
+    for (int i = 0; i < warmup + runs_wanted; i++) {
+        struct run r;
+        sampler.run = i - warmup + 1;
+        if (run_once(command, quiet, i >= warmup && sampler.timeline ? &sampler : NULL, &r) < 0) {
+            fprintf(stderr, "Run %d failed, stopping\n", i + 1);
+            free(runs);
+            return 2;
+        }
+        if (i >= warmup)
+            runs[i - warmup] = r;
+    }
+
+    printf("%s: %d run(s) after %d warmup\n", command[0], runs_wanted, warmup);
+    printf("%-16s %14s %14s %14s %14s\n", "metric", "mean", "stddev", "min", "median");
+    for (int m = 0; m < METRICS; m++) {
+        struct summary s = summarize(runs, runs_wanted, m);
+        printf("%-16s %14.6f %14.6f %14.6f %14.6f\n", metric_names[m], s.mean, s.stddev, s.min, s.median);
+    }
+    if (sampler.timeline) {
+        printf("timeline: %ld sample(s) every %g ms in %s, peak tree rss %.0f kB, peak cpu %.1f%%\n",
+               sampler.samples, interval_ms, timeline, sampler.peak_rss_kb, sampler.peak_cpu_pct);
+        printf("sampler cpu %.6f s over %.3f s sampled (%.3f%%)\n", sampler.cpu, sampler.sampled_wall,
+               sampler.sampled_wall > 0 ? sampler.cpu / sampler.sampled_wall * 100 : 0);
+        fclose(sampler.timeline);
+    }
+
+    int status = 0;
+    if (csv && write_csv(csv, runs, runs_wanted) < 0)
+        status = 3;
+    if (json && write_json(json, command, warmup, runs, runs_wanted) < 0)
+        status = 3;
+    free(runs);
+    return status;
+}
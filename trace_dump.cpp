@@ -0,0 +1,61 @@
+// Print a trace file written by the ns-3 scenarios (--trace) as CSV:
+//
+//     g++ -O2 -std=c++17 trace_dump.cpp -o trace_dump
+//     ./trace_dump [-k throughput|cwnd|rtt] [-i id] run-10ms-5Mbps-s1.trace
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+#include "tracefile.h"
+
+int main(int argc, char *argv[]) {
+    uint32_t kind = 0;
+    long id = -1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "k:i:")) != -1) {
+        switch (opt) {
+        case 'k':
+            if (strcmp(optarg, "throughput") == 0)
+                kind = TRACE_THROUGHPUT;
+            else if (strcmp(optarg, "cwnd") == 0)
+                kind = TRACE_CWND;
+            else if (strcmp(optarg, "rtt") == 0)
+                kind = TRACE_RTT;
+            else {
+                fprintf(stderr, "Unknown kind %s (expected throughput, cwnd or rtt)\n", optarg);
+                return 1;
+            }
+            break;
+        case 'i': id = atol(optarg); break;
+        default:
+            fprintf(stderr, "Usage: %s [-k throughput|cwnd|rtt] [-i id] file.trace\n", argv[0]);
+            return 1;
+        }
+    }
+    if (optind + 1 != argc) {
+        fprintf(stderr, "Usage: %s [-k throughput|cwnd|rtt] [-i id] file.trace\n", argv[0]);
+        return 1;
+    }
+
+    FILE *file = fopen(argv[optind], "rb");
+    if (!file || !TraceReadHeader(file)) {
+        fprintf(stderr, "%s is not a trace file\n", argv[optind]);
+        return 1;
+    }
+
+    printf("time_s,kind,id,value\n");
+    TraceRecord records[TRACE_BUFFER_RECORDS];
+    size_t n;
+    while ((n = fread(records, sizeof(TraceRecord), TRACE_BUFFER_RECORDS, file)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            const TraceRecord &r = records[i];
+            if ((kind && r.kind != kind) || (id >= 0 && r.id != (uint32_t)id))
+                continue;
+            printf("%.6f,%s,%u,%.9g\n", r.time, TraceKindName(r.kind), r.id, r.value);
+        }
+    }
+    fclose(file);
+    return 0;
+}
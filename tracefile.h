@@ -0,0 +1,101 @@
+// Binary time-series trace files written by the ns-3 scenarios (--trace)
+// and read back by trace_dump.cpp. A file is the 8-byte magic followed by
+// fixed 24-byte TraceRecords in host byte order, in the order they were
+// recorded. Records are collected in a 64 KB buffer and written out a
+// buffer at a time, so recording one is a copy into memory.
+#ifndef TRACEFILE_H
+#define TRACEFILE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#define TRACE_MAGIC "NSTRACE1"
+#define TRACE_BUFFER_RECORDS 2730   // ~64 KB
+
+enum TraceKind : uint32_t
+{
+    TRACE_THROUGHPUT = 1,   // id: FlowMonitor flow, value: Mbps received over the last interval
+    TRACE_CWND = 2,         // id: TCP sender socket, value: congestion window in bytes
+    TRACE_RTT = 3,          // id: TCP sender socket, value: RTT estimate in seconds
+};
+
+struct TraceRecord
+{
+    double time;        // simulation time in seconds
+    double value;
+    uint32_t id;
+    uint32_t kind;
+};
+
+static_assert(sizeof(TraceRecord) == 24, "trace records are 24 bytes on disk");
+
+inline const char *
+TraceKindName(uint32_t kind)
+{
+    switch (kind)
+    {
+    case TRACE_THROUGHPUT: return "throughput_mbps";
+    case TRACE_CWND: return "cwnd_bytes";
+    case TRACE_RTT: return "rtt_s";
+    default: return "unknown";
+    }
+}
+
+class TraceWriter
+{
+  public:
+    // Returns false if the file cannot be created.
+    bool Open(const char *path)
+    {
+        m_file = std::fopen(path, "wb");
+        if (!m_file)
+        {
+            return false;
+        }
+        std::fwrite(TRACE_MAGIC, 1, 8, m_file);
+        return true;
+    }
+
+    void Record(double time, uint32_t kind, uint32_t id, double value)
+    {
+        m_buffer[m_count++] = {time, value, id, kind};
+        if (m_count == TRACE_BUFFER_RECORDS)
+        {
+            Flush();
+        }
+    }
+
+    void Flush()
+    {
+        if (m_file && m_count)
+        {
+            std::fwrite(m_buffer, sizeof(TraceRecord), m_count, m_file);
+        }
+        m_count = 0;
+    }
+
+    ~TraceWriter()
+    {
+        Flush();
+        if (m_file)
+        {
+            std::fclose(m_file);
+        }
+    }
+
+  private:
+    std::FILE *m_file = nullptr;
+    TraceRecord m_buffer[TRACE_BUFFER_RECORDS];
+    size_t m_count = 0;
+};
+
+// Returns false if `file` does not start with the trace magic.
+inline bool
+TraceReadHeader(std::FILE *file)
+{
+    char magic[8];
+    return std::fread(magic, 1, 8, file) == 8 && std::memcmp(magic, TRACE_MAGIC, 8) == 0;
+}
+
+#endif
@@ -0,0 +1,181 @@
+// Batched UDP I/O for server.cpp and client.cpp: up to UDP_BATCH datagrams
+// move per recvmmsg/sendmmsg call. With UDP_GRO enabled on the socket the
+// kernel may hand over several datagrams from one peer glued together in
+// a single slot; udp_for_each_datagram splits them again. On the send side
+// consecutive equal-sized datagrams to the same peer can be merged into a
+// single UDP_SEGMENT (GSO) message that the kernel segments late.
+#ifndef UDP_H
+#define UDP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <sys/socket.h>
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+
+#define UDP_BATCH 64                // datagrams (or GSO/GRO messages) per syscall
+#define UDP_MAX_DATAGRAM 1472       // largest datagram that fits a 1500-byte MTU unfragmented
+#define UDP_GRO_SLOT 65536          // a GRO receive can coalesce up to 64 KB
+#define UDP_MAX_SEGMENTS 64         // datagrams merged into one GSO send
+#define UDP_SEND_BUFFER (256 << 10)
+
+struct UdpRecvBatch {
+    struct mmsghdr msgs[UDP_BATCH];
+    struct iovec iovs[UDP_BATCH];
+    struct sockaddr_in addrs[UDP_BATCH];
+    char control[UDP_BATCH][CMSG_SPACE(sizeof(int))];
+    char *data = nullptr;
+    size_t slot_size = 0;
+};
+
+struct UdpSendBatch {
+    struct mmsghdr msgs[UDP_BATCH];
+    struct iovec iovs[UDP_BATCH];
+    struct sockaddr_in addrs[UDP_BATCH];
+    char control[UDP_BATCH][CMSG_SPACE(sizeof(uint16_t))];
+    uint16_t segment_size[UDP_BATCH];
+    uint16_t segments[UDP_BATCH];
+    int count = 0;
+    size_t used = 0;
+    bool gso = false;
+    char *data = nullptr;
+};
+
+// Slots must hold UDP_GRO_SLOT bytes when GRO is on, since a coalesced
+// read is truncated to the slot otherwise.
+inline void udp_recv_init(UdpRecvBatch &b, size_t slot_size) {
+    b.slot_size = slot_size;
+    b.data = new char[slot_size * UDP_BATCH];
+}
+
+inline void udp_send_init(UdpSendBatch &b, bool gso) {
+    b.gso = gso;
+    b.data = new char[UDP_SEND_BUFFER];
+}
+
+// Returns the number of filled slots, or -1 with errno set.
+inline int udp_recv(int fd, UdpRecvBatch &b, int flags) {
+    for (int i = 0; i < UDP_BATCH; i++) {
+        b.iovs[i].iov_base = b.data + i * b.slot_size;
+        b.iovs[i].iov_len = b.slot_size;
+        struct msghdr &msg = b.msgs[i].msg_hdr;
+        msg.msg_name = &b.addrs[i];
+        msg.msg_namelen = sizeof(b.addrs[i]);
+        msg.msg_iov = &b.iovs[i];
+        msg.msg_iovlen = 1;
+        msg.msg_control = b.control[i];
+        msg.msg_controllen = sizeof(b.control[i]);
+        msg.msg_flags = 0;
+    }
+    return recvmmsg(fd, b.msgs, UDP_BATCH, flags, nullptr);
+}
+
+// Call fn(data, len) for every datagram in slot i, splitting a GRO
+// coalesced read at the segment size the kernel reports.
+template <class Fn>
+inline void udp_for_each_datagram(const UdpRecvBatch &b, int i, Fn fn) {
+    const struct msghdr &msg = b.msgs[i].msg_hdr;
+    const char *data = (const char *)b.iovs[i].iov_base;
+    size_t len = b.msgs[i].msg_len;
+    size_t segment = len;
+    for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR((struct msghdr *)&msg, cm)) {
+        if (cm->cmsg_level == SOL_UDP && cm->cmsg_type == UDP_GRO) {
+            int size;
+            memcpy(&size, CMSG_DATA(cm), sizeof(size));
+            if (size > 0)
+                segment = (size_t)size;
+        }
+    }
+    for (size_t off = 0; off < len; off += segment)
+        fn(data + off, len - off < segment ? len - off : segment);
+}
+
+// Reserve `len` bytes for a datagram to `to` (nullptr on a connected
+// socket). Returns where to write it, or nullptr when the batch is full
+// and has to be flushed first.
+inline char *udp_send_slot(UdpSendBatch &b, const struct sockaddr_in *to, size_t len) {
+    if (b.used + len > UDP_SEND_BUFFER)
+        return nullptr;
+    char *out = b.data + b.used;
+
+    if (b.gso && b.count > 0) {
+        int last = b.count - 1;
+        bool same_peer = to ? (b.msgs[last].msg_hdr.msg_name &&
+                               b.addrs[last].sin_addr.s_addr == to->sin_addr.s_addr &&
+                               b.addrs[last].sin_port == to->sin_port)
+                            : !b.msgs[last].msg_hdr.msg_name;
+        if (same_peer && len == b.segment_size[last] && b.segments[last] < UDP_MAX_SEGMENTS &&
+            b.iovs[last].iov_len + len <= UINT16_MAX - 8) {
+            b.iovs[last].iov_len += len;
+            b.segments[last]++;
+            b.used += len;
+            return out;
+        }
+    }
+    if (b.count == UDP_BATCH)
+        return nullptr;
+
+    int i = b.count++;
+    b.iovs[i].iov_base = out;
+    b.iovs[i].iov_len = len;
+    b.segment_size[i] = (uint16_t)len;
+    b.segments[i] = 1;
+    struct msghdr &msg = b.msgs[i].msg_hdr;
+    memset(&msg, 0, sizeof(msg));
+    if (to) {
+        b.addrs[i] = *to;
+        msg.msg_name = &b.addrs[i];
+        msg.msg_namelen = sizeof(b.addrs[i]);
+    }
+    msg.msg_iov = &b.iovs[i];
+    msg.msg_iovlen = 1;
+    b.used += len;
+    return out;
+}
+
+// Send everything queued with as few sendmmsg calls as the socket allows
+// and empty the batch. Messages the socket refuses (EAGAIN on a
+// non-blocking socket, or an error) are dropped, as UDP would anyway.
+// Returns the number of syscalls made.
+inline int udp_send_flush(int fd, UdpSendBatch &b) {
+    for (int i = 0; i < b.count; i++) {
+        if (b.segments[i] < 2)
+            continue;
+        struct msghdr &msg = b.msgs[i].msg_hdr;
+        msg.msg_control = b.control[i];
+        msg.msg_controllen = sizeof(b.control[i]);
+        struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+        cm->cmsg_level = SOL_UDP;
+        cm->cmsg_type = UDP_SEGMENT;
+        cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+        memcpy(CMSG_DATA(cm), &b.segment_size[i], sizeof(uint16_t));
+    }
+
+    int syscalls = 0, sent = 0;
+    while (sent < b.count) {
+        int n = sendmmsg(fd, b.msgs + sent, b.count - sent, 0);
+        syscalls++;
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            n = 1;      // skip the message the kernel rejected
+        }
+        sent += n;
+    }
+    b.count = 0;
+    b.used = 0;
+    return syscalls;
+}
+
+#endif
@@ -0,0 +1,62 @@
+// Unix stream sockets named by a filesystem path, for the local control
+// channels: the shared-memory setup socket (-m, shmring.h) and the
+// metrics socket (server -s, client -S).
+#ifndef UNIXSOCK_H
+#define UNIXSOCK_H
+
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Fill `addr` for `path`. Returns false if the path does not fit.
+inline bool unix_socket_address(const char *path, struct sockaddr_un &addr) {
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path))
+        return false;
+    strcpy(addr.sun_path, path);
+    return true;
+}
+
+// Listen at `path`, replacing a stale socket left there. Returns -1 on
+// failure with errno set.
+inline int unix_listen(const char *path) {
+    struct sockaddr_un addr;
+    if (!unix_socket_address(path, addr)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(path);
+    if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, SOMAXCONN) < 0) {
+        int saved = errno;
+        if (fd >= 0)
+            close(fd);
+        errno = saved;
+        return -1;
+    }
+    return fd;
+}
+
+// Connect to the socket at `path`. Returns -1 on failure with errno set.
+inline int unix_connect(const char *path) {
+    struct sockaddr_un addr;
+    if (!unix_socket_address(path, addr)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+    return fd;
+}
+
+#endif
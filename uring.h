@@ -0,0 +1,207 @@
+// Minimal io_uring plumbing for server.cpp, talking to the kernel through
+// the raw syscalls so no liburing is needed. Covers exactly what the
+// server uses: one submission/completion ring pair, batched submission
+// and a single provided-buffer ring (IORING_REGISTER_PBUF_RING) that
+// multishot recv picks its buffers from.
+#ifndef URING_H
+#define URING_H
+
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+struct Uring {
+    int fd = -1;
+    unsigned *sq_head, *sq_tail, *sq_mask;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    unsigned sq_entries;
+    unsigned sqe_tail = 0;      // next free SQE, published to sq_tail on submit
+    unsigned to_submit = 0;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+
+    // Provided buffers for multishot recv. The ring is addressed as a plain
+    // io_uring_buf array: the kernel's io_uring_buf_ring declares `bufs`
+    // with __DECLARE_FLEX_ARRAY, which lands at offset 8 instead of 0 when
+    // compiled as C++. The ring tail overlays bufs[0].resv.
+    struct io_uring_buf *buf_ring = nullptr;
+    char *buf_base = nullptr;
+    unsigned buf_count = 0, buf_size = 0;
+    uint16_t buf_tail = 0;
+};
+
+inline int uring_enter(Uring &ring, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, ring.fd, to_submit, min_complete, flags, nullptr, 0);
+}
+
+// Returns 0, or -errno if the kernel refuses (old kernel, seccomp, ...).
+inline int uring_init(Uring &ring, unsigned entries) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    p.flags = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_COOP_TASKRUN;
+    ring.fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+    if (ring.fd < 0 && errno == EINVAL) {
+        // Kernels before 6.0 reject the optimisation flags.
+        memset(&p, 0, sizeof(p));
+        ring.fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+    }
+    if (ring.fd < 0)
+        return -errno;
+
+    size_t sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    size_t cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    bool single_mmap = p.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap)
+        sq_len = cq_len = sq_len > cq_len ? sq_len : cq_len;
+
+    char *sq = (char *)mmap(nullptr, sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                            ring.fd, IORING_OFF_SQ_RING);
+    if (sq == MAP_FAILED)
+        return -errno;
+    char *cq = sq;
+    if (!single_mmap) {
+        cq = (char *)mmap(nullptr, cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          ring.fd, IORING_OFF_CQ_RING);
+        if (cq == MAP_FAILED)
+            return -errno;
+    }
+    ring.sqes = (struct io_uring_sqe *)mmap(nullptr, p.sq_entries * sizeof(struct io_uring_sqe),
+                                            PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                            ring.fd, IORING_OFF_SQES);
+    if (ring.sqes == MAP_FAILED)
+        return -errno;
+
+    ring.sq_head = (unsigned *)(sq + p.sq_off.head);
+    ring.sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    ring.sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+    ring.sq_entries = p.sq_entries;
+    ring.cq_head = (unsigned *)(cq + p.cq_off.head);
+    ring.cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    ring.cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+    ring.cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+    // SQE slot i always sits at index i of the indirection array.
+    unsigned *array = (unsigned *)(sq + p.sq_off.array);
+    for (unsigned i = 0; i < p.sq_entries; i++)
+        array[i] = i;
+    ring.sqe_tail = *ring.sq_tail;
+    return 0;
+}
+
+// Make queued SQEs visible and enter the kernel once for all of them,
+// optionally waiting for at least `wait_for` completions.
+inline int uring_submit(Uring &ring, unsigned wait_for) {
+    __atomic_store_n(ring.sq_tail, ring.sqe_tail, __ATOMIC_RELEASE);
+    unsigned n = ring.to_submit;
+    ring.to_submit = 0;
+    if (n == 0 && wait_for == 0)
+        return 0;
+    int ret;
+    do {
+        ret = uring_enter(ring, n, wait_for, wait_for ? IORING_ENTER_GETEVENTS : 0);
+    } while (ret < 0 && errno == EINTR);
+    return ret;
+}
+
+// Next free SQE, zeroed. Flushes the queue first if it is full.
+inline struct io_uring_sqe *uring_get_sqe(Uring &ring) {
+    unsigned head = __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE);
+    if (ring.sqe_tail - head >= ring.sq_entries)
+        uring_submit(ring, 0);
+    struct io_uring_sqe *sqe = &ring.sqes[ring.sqe_tail & *ring.sq_mask];
+    memset(sqe, 0, sizeof(*sqe));
+    ring.sqe_tail++;
+    ring.to_submit++;
+    return sqe;
+}
+
+// Calls f(cqe) for every completion that is ready, then releases them.
+// Returns how many were handled.
+template <typename F>
+inline unsigned uring_for_each_cqe(Uring &ring, F f) {
+    unsigned head = *ring.cq_head;
+    unsigned tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+    unsigned n = 0;
+    for (; head != tail; head++, n++)
+        f(&ring.cqes[head & *ring.cq_mask]);
+    __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+    return n;
+}
+
+inline void uring_prep_multishot_accept(struct io_uring_sqe *sqe, int fd, uint64_t user_data) {
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->user_data = user_data;
+}
+
+inline void uring_prep_multishot_recv(struct io_uring_sqe *sqe, int fd, uint16_t group, uint64_t user_data) {
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = group;
+    sqe->user_data = user_data;
+}
+
+inline void uring_prep_send(struct io_uring_sqe *sqe, int fd, const void *buf, size_t len, uint64_t user_data) {
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)buf;
+    sqe->len = (uint32_t)len;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = user_data;
+}
+
+// Hand buffer `bid` (back) to the kernel. Takes effect on uring_buf_commit.
+inline void uring_buf_push(Uring &ring, uint16_t bid) {
+    struct io_uring_buf *buf = &ring.buf_ring[ring.buf_tail & (ring.buf_count - 1)];
+    buf->addr = (uint64_t)(uintptr_t)(ring.buf_base + (size_t)bid * ring.buf_size);
+    buf->len = ring.buf_size;
+    buf->bid = bid;
+    ring.buf_tail++;
+}
+
+inline void uring_buf_commit(Uring &ring) {
+    __atomic_store_n(&ring.buf_ring[0].resv, ring.buf_tail, __ATOMIC_RELEASE);
+}
+
+inline char *uring_buf(Uring &ring, uint16_t bid) {
+    return ring.buf_base + (size_t)bid * ring.buf_size;
+}
+
+// Register `count` (a power of two) buffers of `size` bytes as buffer
+// group `group`. Returns 0 or -errno.
+inline int uring_setup_buffers(Uring &ring, uint16_t group, unsigned count, unsigned size) {
+    size_t ring_len = count * sizeof(struct io_uring_buf);
+    void *mem = mmap(nullptr, ring_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if (mem == MAP_FAILED)
+        return -errno;
+    ring.buf_ring = (struct io_uring_buf *)mem;
+    ring.buf_base = (char *)mmap(nullptr, (size_t)count * size, PROT_READ | PROT_WRITE,
+                                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if (ring.buf_base == MAP_FAILED)
+        return -errno;
+    ring.buf_count = count;
+    ring.buf_size = size;
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)mem;
+    reg.ring_entries = count;
+    reg.bgid = group;
+    if (syscall(__NR_io_uring_register, ring.fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+        return -errno;
+
+    for (unsigned i = 0; i < count; i++)
+        uring_buf_push(ring, (uint16_t)i);
+    uring_buf_commit(ring);
+    return 0;
+}
+
+#endif